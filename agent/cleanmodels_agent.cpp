@@ -0,0 +1,510 @@
+#include "remoteprotocol.h"
+#include "workerprotocol.h"
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QHostAddress>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QSet>
+#include <QStandardPaths>
+#include <QStringBuilder>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QTimer>
+
+// Runs cleanmodels-cli for a front end on another host. With --listen it
+// waits for chunks and cleans them in a temporary folder, one connection per
+// chunk. With --remote the front end starts it in place of the CLI, see
+// remoteprotocol.h. CLEANMODELS_CLI points the agent at another build of the
+// CLI or at the worker stub. Both sides take the shared token from
+// CLEANMODELS_AGENT_TOKEN, the agent turns down chunks without it.
+
+namespace
+{
+QString option(const QString& optionsText, const QString& key)
+{
+    QRegularExpression rx(":-asserta\\(" % QRegularExpression::escape(key) % "\\('(.*)'\\)\\)\\.");
+    QRegularExpressionMatch match = rx.match(optionsText);
+    return match.hasMatch() ? match.captured(1) : QString();
+}
+
+QString withOption(const QString& optionsText, const QString& key, const QString& value)
+{
+    QRegularExpression rx("^:-asserta\\(" % QRegularExpression::escape(key) % "\\(.*\\)\\)\\.$", QRegularExpression::MultilineOption);
+    QString text = optionsText;
+    text.replace(rx, ":-asserta(" % key % "('" % value % "')).");
+    return text;
+}
+
+// The options are consulted by the CLI, so anything but the plain facts the
+// front end writes would run on this host
+bool plainOptions(const QString& optionsText)
+{
+    static const QString arg = R"((?:'(?:[^'\\]|\\.|'')*'|[\w.+-]+))";
+    static const QRegularExpression rxFact("^:-asserta\\(\\w+\\(" % arg % "(?:," % arg % ")*\\)\\)\\.$");
+    for (const QString &line : optionsText.split('\n'))
+    {
+        const QString trimmed = line.trimmed();
+        if (!trimmed.isEmpty() && !trimmed.startsWith('%') && !rxFact.match(trimmed).hasMatch())
+            return false;
+    }
+    return true;
+}
+
+// Only the arguments the front end passes, the options path is the agent's
+bool plainArguments(const QStringList& args)
+{
+    for (const QString &arg : args)
+    {
+        if (arg != "-d" && arg != WorkerProtocol::ServeOption)
+            return false;
+    }
+    return true;
+}
+
+// Takes as long for any wrong token of the same length
+bool sameToken(const QByteArray& a, const QByteArray& b)
+{
+    if (a.size() != b.size())
+        return false;
+    char diff = 0;
+    for (int i = 0; i < a.size(); ++i)
+        diff |= a.at(i) ^ b.at(i);
+    return diff == 0;
+}
+
+bool writeFile(const QString& path, const QByteArray& data)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+// One chunk of a front end, the connection closing stops the CLI
+class AgentSession : public QObject
+{
+public:
+    AgentSession(QTcpSocket *socket, const QString& cliPath, const QByteArray& token, QObject *parent)
+        : QObject(parent), m_pSocket(socket), m_sCliPath(cliPath), m_token(token)
+    {
+        m_pSocket->setParent(this);
+        m_pSocket->setSocketOption(QAbstractSocket::KeepAliveOption, 1);
+        connect(m_pSocket, &QTcpSocket::readyRead, this, [this]() { onReadyRead(); });
+        connect(m_pSocket, &QTcpSocket::disconnected, this, [this]() { close(); });
+        m_heartbeat.setInterval(RemoteProtocol::HeartbeatMs);
+        connect(&m_heartbeat, &QTimer::timeout, this, [this]() { sendMessage(RemoteProtocol::Alive); });
+    }
+
+    ~AgentSession() override
+    {
+        if (m_pProcess)
+        {
+            m_pProcess->disconnect(this);
+            m_pProcess->kill();
+            m_pProcess->waitForFinished(3000);
+        }
+    }
+
+private:
+    void onReadyRead()
+    {
+        if (m_bRefused)
+        {
+            m_pSocket->readAll();
+            return;
+        }
+        m_buffer += m_pSocket->readAll();
+        QByteArray payload;
+        bool error = false;
+        // The chunk is only buffered for a peer that sent the token first
+        if (!m_bAuthenticated)
+        {
+            if (!RemoteProtocol::takeFrame(m_buffer, &payload, &error, RemoteProtocol::MaxHelloFrame))
+            {
+                if (error)
+                    close();
+                return;
+            }
+            QDataStream in(payload);
+            in.setVersion(RemoteProtocol::StreamVersion);
+            quint8 type = 0;
+            QByteArray token;
+            in >> type >> token;
+            if (type != RemoteProtocol::Hello || !sameToken(token, m_token))
+            {
+                m_bRefused = true;
+                m_buffer.clear();
+                sendLine(1, "*** The agent refused the token\n");
+                finish(2, false);
+                return;
+            }
+            m_bAuthenticated = true;
+        }
+        if (RemoteProtocol::takeFrame(m_buffer, &payload, &error) && !m_pProcess)
+            startTask(payload);
+        else if (error)
+            close();
+    }
+
+    void startTask(const QByteArray& payload)
+    {
+        QDataStream in(payload);
+        in.setVersion(RemoteProtocol::StreamVersion);
+        quint8 type = 0;
+        QStringList args;
+        QString options;
+        quint32 count = 0;
+        in >> type >> args >> options >> count;
+        if (type != RemoteProtocol::Task || !plainArguments(args) || !plainOptions(options) || !m_workDir.isValid() || m_sCliPath.isEmpty())
+        {
+            finish(2, false);
+            return;
+        }
+        m_sInDir = m_workDir.filePath("in");
+        m_sOutDir = m_workDir.filePath("out");
+        QDir().mkpath(m_sInDir);
+        QDir().mkpath(m_sOutDir);
+        for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+        {
+            QString name;
+            QByteArray data;
+            in >> name >> data;
+            // Only plain names, the chunk is always a single folder
+            if (name.contains('/') || name.contains('\\') || name.startsWith('.') || !writeFile(m_sInDir % "/" % name, data))
+            {
+                finish(2, false);
+                return;
+            }
+        }
+        if (in.status() != QDataStream::Ok)
+        {
+            finish(2, false);
+            return;
+        }
+        options = withOption(options, "g_indir", m_sInDir);
+        options = withOption(options, "g_outdir", m_sOutDir);
+        options = withOption(options, "g_logfile", m_workDir.filePath("cm-qt.log"));
+        options = withOption(options, "g_small_log", m_workDir.filePath("cm-qt_summary.log"));
+        const QString optionsPath = m_workDir.filePath("options.pl");
+        if (!writeFile(optionsPath, options.toUtf8()))
+        {
+            finish(2, false);
+            return;
+        }
+
+        QByteArray started;
+        QDataStream out(&started, QIODevice::WriteOnly);
+        out.setVersion(RemoteProtocol::StreamVersion);
+        out << quint8(RemoteProtocol::Started) << m_sInDir << m_sOutDir;
+        m_pSocket->write(RemoteProtocol::frame(started));
+
+        m_pProcess = new QProcess(this);
+        connect(m_pProcess, &QProcess::readyReadStandardOutput, this, [this]() { onOutput(0); });
+        connect(m_pProcess, &QProcess::readyReadStandardError, this, [this]() { onOutput(1); });
+        connect(m_pProcess, static_cast<void(QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished), this, [this](int exitCode, QProcess::ExitStatus status) {
+            onOutput(0);
+            onOutput(1);
+            for (int channel = 0; channel < 2; ++channel)
+            {
+                if (!m_partial[channel].isEmpty())
+                    sendLine(channel, m_partial[channel]);
+            }
+            // Whatever the CLI wrote without reporting it, e.g. walkmeshes
+            QDirIterator it(m_sOutDir, QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext())
+                sendFile(it.next());
+            finish(exitCode, status == QProcess::CrashExit);
+        });
+        args << optionsPath;
+        m_pProcess->start(m_sCliPath, args);
+        if (!m_pProcess->waitForStarted())
+        {
+            m_pProcess->disconnect(this);
+            finish(2, false);
+            return;
+        }
+        m_heartbeat.start();
+    }
+
+    void onOutput(int channel)
+    {
+        m_pProcess->setReadChannel(channel ? QProcess::StandardError : QProcess::StandardOutput);
+        m_partial[channel] += m_pProcess->readAll();
+        int newline;
+        while ((newline = m_partial[channel].indexOf('\n')) >= 0)
+        {
+            const QByteArray line = m_partial[channel].left(newline + 1);
+            m_partial[channel].remove(0, newline + 1);
+            sendLine(channel, line);
+        }
+    }
+
+    // Written models travel ahead of the line reporting them, the front end
+    // picks them up as soon as it reads that line
+    void sendLine(int channel, const QByteArray& line)
+    {
+        static const QRegularExpression rxWritten("(.*) written\\.");
+        const QRegularExpressionMatch written = rxWritten.match(QString::fromUtf8(line).trimmed());
+        if (written.hasMatch())
+        {
+            const QString path = QDir(m_sOutDir).absoluteFilePath(written.captured(1).trimmed());
+            if (QFileInfo(path).isFile())
+                sendFile(path);
+        }
+        QByteArray payload;
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        out.setVersion(RemoteProtocol::StreamVersion);
+        out << quint8(RemoteProtocol::Line) << quint8(channel) << line;
+        m_pSocket->write(RemoteProtocol::frame(payload));
+    }
+
+    void sendFile(const QString& path)
+    {
+        const QString cleanPath = QDir::cleanPath(path);
+        if (!cleanPath.startsWith(QDir::cleanPath(m_sOutDir) % "/"))
+            return;
+        const QString relPath = QDir(m_sOutDir).relativeFilePath(cleanPath);
+        if (m_sent.contains(relPath))
+            return;
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly))
+            return;
+        m_sent.insert(relPath);
+        QByteArray payload;
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        out.setVersion(RemoteProtocol::StreamVersion);
+        out << quint8(RemoteProtocol::File) << relPath << file.readAll();
+        m_pSocket->write(RemoteProtocol::frame(payload));
+    }
+
+    void sendMessage(RemoteProtocol::Message type)
+    {
+        QByteArray payload;
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        out.setVersion(RemoteProtocol::StreamVersion);
+        out << quint8(type);
+        m_pSocket->write(RemoteProtocol::frame(payload));
+    }
+
+    void finish(int exitCode, bool crashed)
+    {
+        m_heartbeat.stop();
+        QByteArray payload;
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        out.setVersion(RemoteProtocol::StreamVersion);
+        out << quint8(RemoteProtocol::Finished) << qint32(exitCode) << crashed;
+        m_pSocket->write(RemoteProtocol::frame(payload));
+        m_pSocket->disconnectFromHost();
+    }
+
+    void close()
+    {
+        m_heartbeat.stop();
+        deleteLater();
+    }
+
+    QTcpSocket *m_pSocket;
+    QString m_sCliPath;
+    QByteArray m_token;
+    bool m_bAuthenticated = false;
+    bool m_bRefused = false;
+    QProcess *m_pProcess = nullptr;
+    QTemporaryDir m_workDir;
+    QString m_sInDir;
+    QString m_sOutDir;
+    QByteArray m_buffer;
+    QByteArray m_partial[2];
+    QSet<QString> m_sent;
+    QTimer m_heartbeat;
+};
+
+int runAgent(QCoreApplication& app, quint16 port, const QHostAddress& address)
+{
+    QTextStream err(stderr);
+    const QByteArray token = qgetenv(RemoteProtocol::TokenVariable);
+    if (token.isEmpty())
+    {
+        err << "Set " << RemoteProtocol::TokenVariable << " to the token the front end uses\n";
+        return 2;
+    }
+    QString cliPath = QFile::decodeName(qgetenv("CLEANMODELS_CLI"));
+    if (cliPath.isEmpty())
+        cliPath = QStandardPaths::findExecutable("cleanmodels-cli");
+    if (cliPath.isEmpty())
+        cliPath = QStandardPaths::findExecutable("cleanmodels-cli", QStringList(QCoreApplication::applicationDirPath()));
+    if (cliPath.isEmpty())
+    {
+        err << "cleanmodels-cli not found, set CLEANMODELS_CLI\n";
+        return 2;
+    }
+    QTcpServer server;
+    QObject::connect(&server, &QTcpServer::newConnection, [&server, &cliPath, &token]() {
+        while (QTcpSocket *socket = server.nextPendingConnection())
+            new AgentSession(socket, cliPath, token, &server);
+    });
+    if (address.isNull() || !server.listen(address, port))
+    {
+        err << "Cannot listen on " << address.toString() << " port " << port << ": " << server.errorString() << "\n";
+        return 2;
+    }
+    err << "Cleaning with " << cliPath << " on " << server.serverAddress().toString() << " port " << server.serverPort() << "\n";
+    err.flush();
+    return app.exec();
+}
+
+int runRemote(const QString& address, QStringList args)
+{
+    QTextStream err(stderr);
+    const int colon = address.lastIndexOf(':');
+    const QString host = colon < 0 ? address : address.left(colon);
+    const quint16 port = colon < 0 ? RemoteProtocol::DefaultPort : address.mid(colon + 1).toUShort();
+    if (args.isEmpty())
+    {
+        err << "usage: cleanmodels-agent " << RemoteProtocol::RemoteOption << " host[:port] [-d] options.pl\n";
+        return 2;
+    }
+    QFile optionsFile(args.takeLast());
+    if (!optionsFile.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        err << "Cannot read " << optionsFile.fileName() << "\n";
+        return 2;
+    }
+    const QString options = QString::fromUtf8(optionsFile.readAll());
+    const QString inDir = QDir(option(options, "g_indir")).absolutePath();
+    const QString outDir = QDir(option(options, "g_outdir")).absolutePath();
+    const QString pattern = option(options, "g_pattern");
+    const QStringList models = QDir(inDir).entryList(QStringList(pattern.isEmpty() ? QString("*.mdl") : pattern), QDir::Files, QDir::Name);
+
+    QByteArray task;
+    QDataStream stream(&task, QIODevice::WriteOnly);
+    stream.setVersion(RemoteProtocol::StreamVersion);
+    stream << quint8(RemoteProtocol::Task) << args << options << quint32(models.count());
+    for (const QString &model : models)
+    {
+        QFile file(inDir % "/" % model);
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            err << "*** Cannot read " << file.fileName() << "\n";
+            return 2;
+        }
+        stream << model << file.readAll();
+    }
+
+    QTcpSocket socket;
+    socket.connectToHost(host, port);
+    if (!socket.waitForConnected(RemoteProtocol::TimeoutMs))
+    {
+        err << "*** Cannot reach agent " << address << ": " << socket.errorString() << "\n";
+        return RemoteProtocol::LostExitCode;
+    }
+    socket.setSocketOption(QAbstractSocket::KeepAliveOption, 1);
+    QByteArray hello;
+    QDataStream helloStream(&hello, QIODevice::WriteOnly);
+    helloStream.setVersion(RemoteProtocol::StreamVersion);
+    helloStream << quint8(RemoteProtocol::Hello) << qgetenv(RemoteProtocol::TokenVariable);
+    socket.write(RemoteProtocol::frame(hello));
+    socket.write(RemoteProtocol::frame(task));
+    while (socket.bytesToWrite() > 0)
+    {
+        if (!socket.waitForBytesWritten(RemoteProtocol::TimeoutMs))
+        {
+            err << "*** Lost agent " << address << ": " << socket.errorString() << "\n";
+            return RemoteProtocol::LostExitCode;
+        }
+    }
+    QFile output[2];
+    output[0].open(stdout, QIODevice::WriteOnly | QIODevice::Unbuffered);
+    output[1].open(stderr, QIODevice::WriteOnly | QIODevice::Unbuffered);
+
+    // Paths on the agent are reported as the local ones
+    QByteArray remoteIn, remoteOut;
+    QByteArray buffer;
+    for (;;)
+    {
+        if (!socket.waitForReadyRead(RemoteProtocol::TimeoutMs))
+            break;
+        buffer += socket.readAll();
+        QByteArray payload;
+        bool error = false;
+        while (RemoteProtocol::takeFrame(buffer, &payload, &error))
+        {
+            QDataStream in(payload);
+            in.setVersion(RemoteProtocol::StreamVersion);
+            quint8 type = 0;
+            in >> type;
+            if (type == RemoteProtocol::Started)
+            {
+                QString agentIn, agentOut;
+                in >> agentIn >> agentOut;
+                remoteIn = agentIn.toUtf8();
+                remoteOut = agentOut.toUtf8();
+            }
+            else if (type == RemoteProtocol::Line)
+            {
+                quint8 channel = 0;
+                QByteArray line;
+                in >> channel >> line;
+                if (!remoteOut.isEmpty())
+                    line.replace(remoteOut, outDir.toUtf8());
+                if (!remoteIn.isEmpty())
+                    line.replace(remoteIn, inDir.toUtf8());
+                err.flush();
+                output[channel ? 1 : 0].write(line);
+            }
+            else if (type == RemoteProtocol::File)
+            {
+                QString relPath;
+                QByteArray data;
+                in >> relPath >> data;
+                // Nothing the agent sends lands outside the output folder
+                const QString path = QDir::cleanPath(outDir % "/" % relPath);
+                if (!path.startsWith(QDir::cleanPath(outDir) % "/") || !writeFile(path, data))
+                {
+                    err << "*** Cannot write " << outDir << "/" << relPath << "\n";
+                    err.flush();
+                }
+            }
+            else if (type == RemoteProtocol::Finished)
+            {
+                qint32 exitCode = 0;
+                bool crashed = false;
+                in >> exitCode >> crashed;
+                if (crashed)
+                {
+                    err << "*** cleanmodels-cli crashed on agent " << address << "\n";
+                    return 70;
+                }
+                return exitCode;
+            }
+        }
+        if (error)
+            break;
+    }
+    err << "*** Lost agent " << address << ": " << socket.errorString() << "\n";
+    return RemoteProtocol::LostExitCode;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments().mid(1);
+    if (args.size() >= 1 && args.first() == RemoteProtocol::ListenOption)
+    {
+        // Other hosts only reach the agent when it is bound to an address of theirs
+        const quint16 port = args.size() >= 2 ? args.at(1).toUShort() : RemoteProtocol::DefaultPort;
+        const QHostAddress address(args.size() >= 3 ? args.at(2) : QString("127.0.0.1"));
+        return runAgent(app, port, address);
+    }
+    if (args.size() >= 2 && args.first() == RemoteProtocol::RemoteOption)
+        return runRemote(args.at(1), args.mid(2));
+    QTextStream(stderr) << "usage: cleanmodels-agent " << RemoteProtocol::ListenOption << " [port [address]]\n"
+                        << "       cleanmodels-agent " << RemoteProtocol::RemoteOption << " host[:port] [-d] options.pl\n";
+    return 2;
+}
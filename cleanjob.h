@@ -0,0 +1,78 @@
+#ifndef CLEANJOB_H
+#define CLEANJOB_H
+#include "cleantask.h"
+#include "dirwalker.h"
+#include "mdlformat.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+class DuplicateScanner;
+class ErfArchive;
+class ErfWriter;
+class QTableWidget;
+class QTableWidgetItem;
+class QTemporaryDir;
+class QTextBrowser;
+class QWidget;
+
+// An input and output folder cleaned with a snapshot of the options. The
+// run started with the Clean button is a job too, it reports into the main
+// window while queued jobs bring their own results table and log.
+struct CleanJob
+{
+    enum State { Queued, Listing, Running, Finished, Failed, Aborted };
+
+    int id = 0;
+    QString name;
+    QString inDir;
+    QString outDir;
+    QString pattern;
+    QString options; // last_dirs.pl as it was when the job was queued
+    int priority = 0; // jobs of the highest priority share the workers, lower ones wait
+    bool recursive = false;
+    bool decompileOnly = false;
+    bool dedupe = false;
+    bool watched = false; // fed by watch mode, keeps running while the input is watched
+    State state = Queued;
+
+    QVector<ModelEntry> entries;
+    QHash<QString, QStringList> duplicates; // representative -> identical models
+    QHash<QString, QString> duplicateOf; // identical model -> representative
+    QHash<QString, MdlStats> stats; // of the ASCII models, when they were profiled
+    QWidget *page = nullptr; // holds table and log, null for the main window's job
+    QTableWidget *table = nullptr;
+    QHash<QString, QTableWidgetItem*> items;
+    QTextBrowser *log = nullptr;
+    QHash<QString, QVector<QPair<int, int>>> logSlices; // character ranges of each model's lines in log
+    QHash<QString, QVector<quint16>> modelFixes; // fix lines per FixCatalog category, models with fixes only
+    QVector<int> fixTotals; // per category over the job
+    QSet<QString> unmatchedFixes; // models whose fix lines did not add up to the CLI's count
+    DirWalker *walker = nullptr;
+    DuplicateScanner *scanner = nullptr;
+
+    ErfArchive *inArchive = nullptr;
+    ErfWriter *outArchive = nullptr;
+    QTemporaryDir *runDir = nullptr;
+    QTemporaryDir *stageDir = nullptr; // inside the output folder, so moving out of it is a rename
+    QTemporaryDir *selectionDir = nullptr; // inside the input folder, so selections are hard links
+    QList<CleanTask> cleanQueue;
+    QList<CleanTask> decompileQueue;
+    QList<CleanTask> handoffQueue; // decompiled models waiting for a clean worker
+    int taskSerial = 0;
+    int commitsPending = 0;
+    int cleaned = 0;
+    int failed = 0;
+    bool aborted = false;
+    bool selectionsCopied = false; // already logged that models are copied rather than linked
+    QElapsedTimer elapsed;
+
+    bool isActive() const { return state == Listing || state == Running; }
+    bool hasQueuedTasks() const { return !cleanQueue.isEmpty() || !decompileQueue.isEmpty() || !handoffQueue.isEmpty(); }
+};
+
+#endif // CLEANJOB_H
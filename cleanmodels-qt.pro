@@ -2,6 +2,13 @@ QT       += core gui
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
+# CONFIG += with_network builds the parts that need Qt Network, the
+# cleanmodels-agent executable is only built by CMake
+with_network {
+    QT += network
+    DEFINES += CLEANMODELS_NETWORK
+}
+
 TARGET = cleanmodels-qt
 TEMPLATE = app
 
@@ -17,14 +24,56 @@ DEFINES += QT_DEPRECATED_WARNINGS
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+        dirwalker.cpp \
+        duplicatescanner.cpp \
+        erfarchive.cpp \
+        erfwriter.cpp \
+        fixcatalog.cpp \
         fsmodel.cpp \
+        limitedprocess.cpp \
+        loadmonitor.cpp \
+        logindex.cpp \
         main.cpp \
         mainwindow.cpp \
-        mainwindow_clean.cpp
+        mainwindow_clean.cpp \
+        mainwindow_jobs.cpp \
+        mainwindow_report.cpp \
+        mainwindow_watch.cpp \
+        mdldiff.cpp \
+        mdldiffdialog.cpp \
+        mdlformat.cpp \
+        mdlstatsscanner.cpp \
+        metrics.cpp \
+        outputcommitter.cpp \
+        prefetcher.cpp \
+        resultsbrowser.cpp \
+        resultsproxy.cpp
 
 HEADERS += \
+        cleanjob.h \
+        cleantask.h \
+        cleanworker.h \
+        dirwalker.h \
+        duplicatescanner.h \
+        erfarchive.h \
+        erfwriter.h \
+        fixcatalog.h \
         fsmodel.h \
-        mainwindow.h
+        limitedprocess.h \
+        loadmonitor.h \
+        logindex.h \
+        mainwindow.h \
+        mdldiff.h \
+        mdldiffdialog.h \
+        mdlformat.h \
+        mdlstatsscanner.h \
+        metrics.h \
+        outputcommitter.h \
+        prefetcher.h \
+        remoteprotocol.h \
+        resultsbrowser.h \
+        resultsproxy.h \
+        workerprotocol.h
 
 FORMS += \
         mainwindow.ui
@@ -0,0 +1,26 @@
+#ifndef CLEANTASK_H
+#define CLEANTASK_H
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// One invocation of cleanmodels-cli over the models of a single folder
+struct CleanTask
+{
+    enum Stage { Clean, Decompile };
+
+    Stage stage = Clean;
+    int jobId = 0;
+    QString inDir;
+    QString outDir;
+    QString pattern;
+    QString relDir; // folder of the models relative to the input root, empty for the root itself
+    QVector<int> archiveEntries; // resources to write into inDir before the run
+    QString sourceDir;
+    QStringList stagedFiles; // models of sourceDir linked into inDir before the run
+    qint64 stagedBytes = 0; // size of stagedFiles, zero when not known
+    bool generatedOptions = false; // run from a per task copy of last_dirs.pl
+    QString cleanOutDir; // decompile runs only, outDir is handed to a clean run writing here
+};
+
+#endif // CLEANTASK_H
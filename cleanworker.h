@@ -0,0 +1,44 @@
+#ifndef CLEANWORKER_H
+#define CLEANWORKER_H
+#include "cleantask.h"
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+// A running cleanmodels-cli process and the parse state of its output
+struct CleanWorker
+{
+    QProcess *process = nullptr;
+    CleanTask task;
+    QString currentModel;
+    QElapsedTimer timer;
+    QElapsedTimer pauseTimer;
+    qint64 pausedMs = 0; // of the current model, left out of its time
+    QByteArray partialLine; // output after the last complete line
+    QByteArray partialErrorLine; // same for stderr
+    QString modelErrors; // stderr of the current model
+    QVector<quint16> modelFixes; // fix lines of the current model per FixCatalog category
+    QSet<QString> doneModels; // written or failed, the rest is retried if the worker dies
+    bool persistent = false; // started with --serve, takes one chunk after another
+    bool idle = false; // persistent and between chunks
+    bool retiring = false; // stdin closed, exits after the current model
+    int served = 0; // models answered with the done line
+    QStringList feed; // models of the chunk not yet handed to a persistent worker
+    QString agent; // host:port of the remote agent running the chunk, empty for local workers
+    int slot = 0; // lowest number free when it started, labels its metrics
+};
+
+// A host running cleanmodels-agent --listen. Its chunks run through a local
+// cleanmodels-agent --remote process that stands in for the CLI.
+struct RemoteAgent
+{
+    QString address; // host:port
+    int slots = 1;
+    int dispatched = 0; // chunks sent this run
+    QElapsedTimer lost; // started when the agent went away, it sits out a while
+};
+
+#endif // CLEANWORKER_H
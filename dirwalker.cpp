@@ -0,0 +1,128 @@
+#include "dirwalker.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QStringBuilder>
+#include <QThread>
+#include <algorithm>
+#include <cctype>
+
+class DirWalkTask : public QRunnable
+{
+public:
+    DirWalkTask(DirWalker *walker, QString relDir) :
+        m_pWalker(walker),
+        m_sRelDir(std::move(relDir))
+    {
+    }
+
+    void run() override
+    {
+        m_pWalker->walk(m_sRelDir);
+    }
+
+private:
+    DirWalker *m_pWalker;
+    QString m_sRelDir;
+};
+
+DirWalker::DirWalker(QObject *parent) :
+    QObject(parent)
+{
+    // Listing is I/O bound, so oversubscribe the cores to keep the disk busy
+    m_pool.setMaxThreadCount(qMax(4, QThread::idealThreadCount() * 2));
+}
+
+DirWalker::~DirWalker()
+{
+    cancel();
+    m_pool.waitForDone();
+}
+
+void DirWalker::start(const QString& root, const QStringList& nameFilters, bool recursive)
+{
+    m_sRoot = root;
+    m_nameFilters = nameFilters;
+    m_bRecursive = recursive;
+    scheduleWalk(QString());
+}
+
+void DirWalker::cancel()
+{
+    m_nCancelled.storeRelease(1);
+}
+
+QVector<ModelEntry> DirWalker::results() const
+{
+    QMutexLocker locker(&m_resultsMutex);
+    return m_results;
+}
+
+bool DirWalker::isASCIIHeader(const QByteArray& head)
+{
+    int lineEnd = head.indexOf('\n');
+    const QByteArray line = (lineEnd < 0 ? head : head.left(lineEnd)).trimmed();
+    return std::all_of(line.begin(), line.end(), [](char c) { return ::isprint(static_cast<unsigned char>(c)); });
+}
+
+void DirWalker::scheduleWalk(const QString& relDir)
+{
+    m_nPending.ref();
+    m_pool.start(new DirWalkTask(this, relDir));
+}
+
+void DirWalker::walk(const QString& relDir)
+{
+    if (!m_nCancelled.loadAcquire())
+    {
+        QDir dir(relDir.isEmpty() ? m_sRoot : m_sRoot % "/" % relDir);
+        if (m_bRecursive)
+        {
+            // Symlinked folders are skipped so a link cycle cannot recurse
+            // forever, dot folders also where they are not hidden, e.g. a
+            // run's selection folders on Windows
+            const QStringList subDirs = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::Readable | QDir::NoSymLinks);
+            for (const QString &subDir : subDirs)
+            {
+                if (!subDir.startsWith('.'))
+                    scheduleWalk(relDir.isEmpty() ? subDir : relDir % "/" % subDir);
+            }
+        }
+
+        dir.setNameFilters(m_nameFilters);
+        const QFileInfoList files = dir.entryInfoList(QDir::Files | QDir::NoDotAndDotDot | QDir::Readable | QDir::CaseSensitive);
+        QVector<ModelEntry> entries;
+        entries.reserve(files.size());
+        for (const QFileInfo &fileInfo : files)
+        {
+            if (m_nCancelled.loadAcquire())
+                break;
+            QFile inputFile(fileInfo.filePath());
+            if (!inputFile.open(QIODevice::ReadOnly))
+                continue;
+            ModelEntry entry;
+            entry.relPath = relDir.isEmpty() ? fileInfo.fileName() : relDir % "/" % fileInfo.fileName();
+            entry.size = inputFile.size();
+            entry.modified = fileInfo.lastModified().toMSecsSinceEpoch();
+            entry.isASCII = isASCIIHeader(inputFile.read(256));
+            entries.append(entry);
+        }
+
+        QMutexLocker locker(&m_resultsMutex);
+        m_results += entries;
+    }
+
+    if (!m_nPending.deref())
+    {
+        {
+            QMutexLocker locker(&m_resultsMutex);
+            std::sort(m_results.begin(), m_results.end(), [](const ModelEntry& a, const ModelEntry& b) {
+                return a.relPath < b.relPath;
+            });
+        }
+        emit finished();
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef DIRWALKER_H
+#define DIRWALKER_H
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+
+struct ModelEntry
+{
+    QString relPath; // relative to the walked root, '/' separated
+    qint64 size = 0;
+    qint64 modified = 0; // ms since the epoch
+    bool isASCII = true;
+    int archiveIndex = -1; // resource index when listed from an ERF/HAK
+};
+
+// Lists the models below a root folder. Every folder is listed by its own
+// task on a private thread pool, so deep trees are scanned concurrently and
+// the walk is bounded by the file system rather than by a single thread.
+class DirWalker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DirWalker(QObject *parent = nullptr);
+    ~DirWalker() override;
+
+    void start(const QString& root, const QStringList& nameFilters, bool recursive);
+    void cancel();
+    QVector<ModelEntry> results() const;
+
+    static bool isASCIIHeader(const QByteArray& head);
+
+signals:
+    void finished();
+
+private:
+    friend class DirWalkTask;
+
+    void scheduleWalk(const QString& relDir);
+    void walk(const QString& relDir);
+
+    QString m_sRoot;
+    QStringList m_nameFilters;
+    bool m_bRecursive = false;
+    QAtomicInt m_nPending;
+    QAtomicInt m_nCancelled;
+    mutable QMutex m_resultsMutex;
+    QVector<ModelEntry> m_results;
+    QThreadPool m_pool;
+};
+
+#endif // DIRWALKER_H
@@ -0,0 +1,126 @@
+#include "duplicatescanner.h"
+#include "erfarchive.h"
+#include <QCryptographicHash>
+#include <QFile>
+#include <QHash>
+#include <QPair>
+#include <QRunnable>
+#include <QStringBuilder>
+
+class DuplicateHashTask : public QRunnable
+{
+public:
+    DuplicateHashTask(DuplicateScanner *scanner, int index) :
+        m_pScanner(scanner),
+        m_nIndex(index)
+    {
+    }
+
+    void run() override
+    {
+        m_pScanner->hashEntry(m_nIndex);
+        m_pScanner->taskDone();
+    }
+
+private:
+    DuplicateScanner *m_pScanner;
+    int m_nIndex;
+};
+
+DuplicateScanner::DuplicateScanner(QObject *parent) :
+    QObject(parent)
+{
+}
+
+DuplicateScanner::~DuplicateScanner()
+{
+    cancel();
+}
+
+void DuplicateScanner::start(const QVector<ModelEntry>& entries, const QString& root, const ErfArchive *archive)
+{
+    m_entries = entries;
+    m_sRoot = root;
+    m_pArchive = archive;
+    m_hashes.resize(entries.size());
+    m_groups.fill(-1, entries.size());
+
+    QHash<qint64, int> sizeCounts;
+    for (const ModelEntry &entry : entries)
+        sizeCounts[entry.size]++;
+    QVector<int> candidates;
+    for (int i = 0; i < entries.size(); ++i)
+    {
+        if (sizeCounts.value(entries.at(i).size) > 1)
+            candidates.append(i);
+    }
+
+    // Hold a reference while queueing so an early finisher cannot complete the scan
+    m_nPending.ref();
+    for (int index : candidates)
+    {
+        m_nPending.ref();
+        m_pool.start(new DuplicateHashTask(this, index));
+    }
+    taskDone();
+}
+
+void DuplicateScanner::cancel()
+{
+    m_nCancelled.storeRelease(1);
+    m_pool.waitForDone();
+}
+
+void DuplicateScanner::hashEntry(int index)
+{
+    if (m_nCancelled.loadAcquire())
+        return;
+    const ModelEntry &entry = m_entries.at(index);
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    if (entry.archiveIndex >= 0 && m_pArchive)
+    {
+        hash.addData(m_pArchive->resourceData(entry.archiveIndex));
+    }
+    else
+    {
+        QFile file(m_sRoot % "/" % entry.relPath);
+        if (!file.open(QIODevice::ReadOnly) || !hash.addData(&file))
+            return;
+    }
+    m_hashes[index] = hash.result();
+}
+
+void DuplicateScanner::taskDone()
+{
+    if (!m_nPending.deref())
+    {
+        if (!m_nCancelled.loadAcquire())
+            buildGroups();
+        emit finished();
+    }
+}
+
+void DuplicateScanner::buildGroups()
+{
+    QHash<QPair<qint64, QByteArray>, int> firstSeen;
+    QHash<int, int> groupOfFirst;
+    for (int i = 0; i < m_entries.size(); ++i)
+    {
+        if (m_hashes.at(i).isEmpty())
+            continue;
+        const QPair<qint64, QByteArray> key(m_entries.at(i).size, m_hashes.at(i));
+        auto found = firstSeen.constFind(key);
+        if (found == firstSeen.constEnd())
+        {
+            firstSeen.insert(key, i);
+            continue;
+        }
+        const int first = found.value();
+        if (!groupOfFirst.contains(first))
+        {
+            groupOfFirst.insert(first, m_nGroupCount++);
+            m_groups[first] = groupOfFirst.value(first);
+        }
+        m_groups[i] = groupOfFirst.value(first);
+    }
+}
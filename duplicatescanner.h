@@ -0,0 +1,51 @@
+#ifndef DUPLICATESCANNER_H
+#define DUPLICATESCANNER_H
+#include "dirwalker.h"
+#include <QAtomicInt>
+#include <QObject>
+#include <QThreadPool>
+#include <QVector>
+
+class ErfArchive;
+
+// Finds byte identical models. Only models that share their size with
+// another one are hashed, each on its own pool task.
+class DuplicateScanner : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DuplicateScanner(QObject *parent = nullptr);
+    ~DuplicateScanner() override;
+
+    // The archive, when given, must stay open until finished() is emitted
+    void start(const QVector<ModelEntry>& entries, const QString& root, const ErfArchive *archive);
+    // Returns once no task touches the inputs any more
+    void cancel();
+
+    // Group number per entry, -1 for models without an identical twin
+    QVector<int> groups() const { return m_groups; }
+    int groupCount() const { return m_nGroupCount; }
+
+signals:
+    void finished();
+
+private:
+    friend class DuplicateHashTask;
+
+    void hashEntry(int index);
+    void taskDone();
+    void buildGroups();
+
+    QVector<ModelEntry> m_entries;
+    QString m_sRoot;
+    const ErfArchive *m_pArchive = nullptr;
+    QVector<QByteArray> m_hashes;
+    QVector<int> m_groups;
+    int m_nGroupCount = 0;
+    QAtomicInt m_nPending;
+    QAtomicInt m_nCancelled;
+    QThreadPool m_pool;
+};
+
+#endif // DUPLICATESCANNER_H
@@ -0,0 +1,162 @@
+#include "erfarchive.h"
+#include <QFileInfo>
+#include <QHash>
+#include <QObject>
+#include <QtEndian>
+
+namespace
+{
+const qint64 HeaderSize = 160;
+const qint64 ResourceEntrySize = 8;
+
+quint32 readU32(const uchar *p)
+{
+    return qFromLittleEndian<quint32>(p);
+}
+
+quint16 readU16(const uchar *p)
+{
+    return qFromLittleEndian<quint16>(p);
+}
+}
+
+ErfArchive::~ErfArchive()
+{
+    close();
+}
+
+bool ErfArchive::open(const QString& path)
+{
+    close();
+    m_sError.clear();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return fail(m_file.errorString());
+    m_nSize = m_file.size();
+    if (m_nSize < HeaderSize)
+        return fail(QObject::tr("File is too small to be an ERF archive"));
+    m_pData = m_file.map(0, m_nSize);
+    if (!m_pData)
+        return fail(m_file.errorString());
+
+    const QByteArray fileType = QByteArray(reinterpret_cast<const char*>(m_pData), 4);
+    const QByteArray version = QByteArray(reinterpret_cast<const char*>(m_pData) + 4, 4);
+    if (fileType != "HAK " && fileType != "ERF " && fileType != "MOD " && fileType != "NWM ")
+        return fail(QObject::tr("Unknown archive type"));
+    qint64 resRefLength = 16;
+    if (version == "V1.1")
+        resRefLength = 32;
+    else if (version != "V1.0")
+        return fail(QObject::tr("Unsupported archive version"));
+    const qint64 keyEntrySize = resRefLength + 8;
+    m_fileType = fileType;
+
+    m_nLanguageCount = readU32(m_pData + 8);
+    m_nLocalizedStringSize = readU32(m_pData + 12);
+    m_nLocalizedStringOffset = readU32(m_pData + 20);
+    m_nDescriptionStrRef = readU32(m_pData + 40);
+    if (m_nLocalizedStringOffset + qint64(m_nLocalizedStringSize) > m_nSize)
+        return fail(QObject::tr("Localized strings run past the end of the file"));
+
+    const quint32 entryCount = readU32(m_pData + 16);
+    const quint32 keyListOffset = readU32(m_pData + 24);
+    const quint32 resourceListOffset = readU32(m_pData + 28);
+    if (keyListOffset + qint64(entryCount) * keyEntrySize > m_nSize ||
+        resourceListOffset + qint64(entryCount) * ResourceEntrySize > m_nSize)
+        return fail(QObject::tr("Archive tables run past the end of the file"));
+
+    m_entries.resize(int(entryCount));
+    for (quint32 i = 0; i < entryCount; ++i)
+    {
+        const uchar *key = m_pData + keyListOffset + i * keyEntrySize;
+        const uchar *res = m_pData + resourceListOffset + i * ResourceEntrySize;
+        ErfEntry &entry = m_entries[int(i)];
+        const char *resRef = reinterpret_cast<const char*>(key);
+        entry.resRef = QString::fromLatin1(resRef, int(qstrnlen(resRef, uint(resRefLength))));
+        entry.resType = readU16(key + resRefLength + 4);
+        entry.offset = readU32(res);
+        entry.size = readU32(res + 4);
+        if (entry.offset + qint64(entry.size) > m_nSize)
+            return fail(QObject::tr("Resource %1 runs past the end of the file").arg(entry.resRef));
+    }
+    return true;
+}
+
+void ErfArchive::close()
+{
+    if (m_pData)
+        m_file.unmap(const_cast<uchar*>(m_pData));
+    m_pData = nullptr;
+    m_nSize = 0;
+    m_fileType.clear();
+    m_nLanguageCount = 0;
+    m_nLocalizedStringSize = 0;
+    m_nLocalizedStringOffset = 0;
+    m_nDescriptionStrRef = 0xFFFFFFFF;
+    m_entries.clear();
+    if (m_file.isOpen())
+        m_file.close();
+}
+
+QByteArray ErfArchive::resourceData(int index) const
+{
+    if (!m_pData || index < 0 || index >= m_entries.size())
+        return QByteArray();
+    const ErfEntry &entry = m_entries.at(index);
+    return QByteArray::fromRawData(reinterpret_cast<const char*>(m_pData) + entry.offset, int(entry.size));
+}
+
+QByteArray ErfArchive::localizedStrings() const
+{
+    if (!m_pData)
+        return QByteArray();
+    return QByteArray::fromRawData(reinterpret_cast<const char*>(m_pData) + m_nLocalizedStringOffset, int(m_nLocalizedStringSize));
+}
+
+QString ErfArchive::resourceFileName(int index) const
+{
+    const ErfEntry &entry = m_entries.at(index);
+    return entry.resRef + "." + extensionForType(entry.resType);
+}
+
+bool ErfArchive::isArchivePath(const QString& path)
+{
+    const QFileInfo info(path);
+    const QString suffix = info.suffix().toLower();
+    return (suffix == "hak" || suffix == "erf" || suffix == "mod") && !info.isDir();
+}
+
+namespace
+{
+const QHash<quint16, QString>& resourceExtensions()
+{
+    static const QHash<quint16, QString> extensions = {
+        {1, "bmp"}, {3, "tga"}, {4, "wav"}, {6, "plt"}, {7, "ini"}, {10, "txt"},
+        {2002, "mdl"}, {2009, "nss"}, {2010, "ncs"}, {2012, "are"}, {2013, "set"},
+        {2014, "ifo"}, {2016, "wok"}, {2017, "2da"}, {2022, "txi"}, {2023, "git"},
+        {2025, "uti"}, {2027, "utc"}, {2029, "dlg"}, {2030, "itp"}, {2032, "utt"},
+        {2033, "dds"}, {2035, "uts"}, {2037, "gff"}, {2040, "ute"}, {2042, "utd"},
+        {2044, "utp"}, {2047, "gui"}, {2051, "utm"}, {2052, "dwk"}, {2053, "pwk"},
+        {2056, "jrl"}, {2058, "utw"}, {2060, "ssf"}, {2064, "ndb"}, {2065, "ptm"},
+        {2066, "ptt"}
+    };
+    return extensions;
+}
+}
+
+QString ErfArchive::extensionForType(quint16 resType)
+{
+    return resourceExtensions().value(resType, QString::number(resType));
+}
+
+quint16 ErfArchive::typeForExtension(const QString& extension)
+{
+    return resourceExtensions().key(extension.toLower(), 0);
+}
+
+bool ErfArchive::fail(const QString& error)
+{
+    close();
+    m_sError = error;
+    return false;
+}
@@ -0,0 +1,63 @@
+#ifndef ERFARCHIVE_H
+#define ERFARCHIVE_H
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+struct ErfEntry
+{
+    QString resRef;
+    quint16 resType = 0;
+    quint32 offset = 0;
+    quint32 size = 0;
+};
+
+// Read only view of a NWN ERF/HAK/MOD archive. The file is memory mapped
+// and resources are handed out as QByteArrays over the mapping, so nothing
+// is copied until the caller writes it somewhere.
+class ErfArchive
+{
+public:
+    enum : quint16 { ResTypeMdl = 2002 };
+
+    ErfArchive() = default;
+    ~ErfArchive();
+    ErfArchive(const ErfArchive&) = delete;
+    ErfArchive& operator=(const ErfArchive&) = delete;
+
+    bool open(const QString& path);
+    void close();
+    bool isOpen() const { return m_pData != nullptr; }
+    QString fileName() const { return m_file.fileName(); }
+    QString errorString() const { return m_sError; }
+
+    QByteArray fileType() const { return m_fileType; }
+    quint32 languageCount() const { return m_nLanguageCount; }
+    QByteArray localizedStrings() const;
+    quint32 descriptionStrRef() const { return m_nDescriptionStrRef; }
+
+    const QVector<ErfEntry>& entries() const { return m_entries; }
+    QByteArray resourceData(int index) const;
+    QString resourceFileName(int index) const;
+
+    static bool isArchivePath(const QString& path);
+    static QString extensionForType(quint16 resType);
+    static quint16 typeForExtension(const QString& extension);
+
+private:
+    bool fail(const QString& error);
+
+    QFile m_file;
+    const uchar *m_pData = nullptr;
+    qint64 m_nSize = 0;
+    QByteArray m_fileType;
+    quint32 m_nLanguageCount = 0;
+    quint32 m_nLocalizedStringSize = 0;
+    quint32 m_nLocalizedStringOffset = 0;
+    quint32 m_nDescriptionStrRef = 0xFFFFFFFF;
+    QVector<ErfEntry> m_entries;
+    QString m_sError;
+};
+
+#endif // ERFARCHIVE_H
@@ -0,0 +1,166 @@
+#include "erfwriter.h"
+#include <QDate>
+#include <QFileInfo>
+#include <QObject>
+#include <QtEndian>
+
+namespace
+{
+const int HeaderSize = 160;
+const int ResRefLength = 16;
+
+void appendU32(QByteArray& buffer, quint32 value)
+{
+    uchar bytes[4];
+    qToLittleEndian<quint32>(value, bytes);
+    buffer.append(reinterpret_cast<const char*>(bytes), 4);
+}
+
+void appendU16(QByteArray& buffer, quint16 value)
+{
+    uchar bytes[2];
+    qToLittleEndian<quint16>(value, bytes);
+    buffer.append(reinterpret_cast<const char*>(bytes), 2);
+}
+}
+
+ErfWriter::ErfWriter(const QString& path) :
+    m_file(path)
+{
+}
+
+bool ErfWriter::open(const QByteArray& fileType)
+{
+    m_fileType = fileType.leftJustified(4, ' ', true);
+    if (!m_file.open(QIODevice::WriteOnly))
+        return fail(m_file.errorString());
+    // Placeholder, the real header is written once the tables are known
+    if (m_file.write(QByteArray(HeaderSize, '\0')) != HeaderSize)
+        return fail(m_file.errorString());
+    return true;
+}
+
+void ErfWriter::setLocalizedStrings(quint32 languageCount, const QByteArray& strings, quint32 descriptionStrRef)
+{
+    m_nLanguageCount = languageCount;
+    // Deep copy, the caller's data may point into a mapping that goes away first
+    m_localizedStrings = QByteArray(strings.constData(), strings.size());
+    m_nDescriptionStrRef = descriptionStrRef;
+}
+
+bool ErfWriter::addResource(const QString& resRef, quint16 resType, const QByteArray& data, QString *error)
+{
+    if (!m_file.isOpen())
+    {
+        fail(QObject::tr("Archive is not open"));
+        return reject(m_sError, error);
+    }
+    if (resRef.toLatin1().size() > ResRefLength)
+        return reject(QObject::tr("Resource name %1 is longer than %2 characters").arg(resRef).arg(ResRefLength), error);
+    // Models of different subfolders may share a name, only one of them fits
+    const QString key = resourceKey(resRef, resType);
+    if (m_keys.contains(key))
+        return reject(QObject::tr("%1 is already in the archive").arg(resRef), error);
+
+    ErfEntry entry;
+    entry.resRef = resRef;
+    entry.resType = resType;
+    entry.offset = quint32(m_file.pos());
+    entry.size = quint32(data.size());
+    if (m_file.write(data) != data.size())
+    {
+        fail(m_file.errorString());
+        return reject(m_sError, error);
+    }
+    m_entries.append(entry);
+    m_keys.insert(key);
+    return true;
+}
+
+bool ErfWriter::contains(const QString& resRef, quint16 resType) const
+{
+    return m_keys.contains(resourceKey(resRef, resType));
+}
+
+bool ErfWriter::commit()
+{
+    if (!m_file.isOpen())
+        return fail(QObject::tr("Archive is not open"));
+
+    const quint32 localizedStringOffset = quint32(m_file.pos());
+    if (m_file.write(m_localizedStrings) != m_localizedStrings.size())
+        return fail(m_file.errorString());
+
+    QByteArray keyList;
+    keyList.reserve(m_entries.count() * (ResRefLength + 8));
+    QByteArray resourceList;
+    resourceList.reserve(m_entries.count() * 8);
+    for (int i = 0; i < m_entries.count(); ++i)
+    {
+        const ErfEntry &entry = m_entries.at(i);
+        keyList.append(entry.resRef.toLatin1().leftJustified(ResRefLength, '\0', true));
+        appendU32(keyList, quint32(i));
+        appendU16(keyList, entry.resType);
+        appendU16(keyList, 0);
+        appendU32(resourceList, entry.offset);
+        appendU32(resourceList, entry.size);
+    }
+    const quint32 keyListOffset = localizedStringOffset + quint32(m_localizedStrings.size());
+    const quint32 resourceListOffset = keyListOffset + quint32(keyList.size());
+    if (m_file.write(keyList) != keyList.size() || m_file.write(resourceList) != resourceList.size())
+        return fail(m_file.errorString());
+
+    const QDate today = QDate::currentDate();
+    QByteArray header = m_fileType;
+    header.append("V1.0");
+    appendU32(header, m_nLanguageCount);
+    appendU32(header, quint32(m_localizedStrings.size()));
+    appendU32(header, quint32(m_entries.count()));
+    appendU32(header, localizedStringOffset);
+    appendU32(header, keyListOffset);
+    appendU32(header, resourceListOffset);
+    appendU32(header, quint32(today.year() - 1900));
+    appendU32(header, quint32(today.dayOfYear() - 1));
+    appendU32(header, m_nDescriptionStrRef);
+    header = header.leftJustified(HeaderSize, '\0');
+    if (!m_file.seek(0) || m_file.write(header) != HeaderSize)
+        return fail(m_file.errorString());
+
+    if (!m_file.commit())
+        return fail(m_file.errorString());
+    return true;
+}
+
+void ErfWriter::cancel()
+{
+    if (m_file.isOpen())
+    {
+        m_file.cancelWriting();
+        m_file.commit();
+    }
+}
+
+QByteArray ErfWriter::fileTypeForPath(const QString& path)
+{
+    return QFileInfo(path).suffix().toUpper().toLatin1().leftJustified(4, ' ', true);
+}
+
+bool ErfWriter::fail(const QString& error)
+{
+    if (m_sError.isEmpty())
+        m_sError = error;
+    cancel();
+    return false;
+}
+
+bool ErfWriter::reject(const QString& reason, QString *error)
+{
+    if (error)
+        *error = reason;
+    return false;
+}
+
+QString ErfWriter::resourceKey(const QString& resRef, quint16 resType)
+{
+    return resRef.toLower() + QLatin1Char('.') + QString::number(resType);
+}
@@ -0,0 +1,47 @@
+#ifndef ERFWRITER_H
+#define ERFWRITER_H
+#include "erfarchive.h"
+#include <QSaveFile>
+#include <QSet>
+
+// Streams resources into a new ERF/HAK/MOD archive. Resource data is
+// appended as it arrives and the key and resource tables are written after
+// the last resource, so the archive can be built without knowing its
+// contents up front. Nothing replaces the target until commit().
+class ErfWriter
+{
+public:
+    explicit ErfWriter(const QString& path);
+    ErfWriter(const ErfWriter&) = delete;
+    ErfWriter& operator=(const ErfWriter&) = delete;
+
+    bool open(const QByteArray& fileType);
+    void setLocalizedStrings(quint32 languageCount, const QByteArray& strings, quint32 descriptionStrRef);
+    // A resource the archive cannot hold is turned down with error set and
+    // the archive stays open for the others
+    bool addResource(const QString& resRef, quint16 resType, const QByteArray& data, QString *error = nullptr);
+    bool contains(const QString& resRef, quint16 resType) const;
+    int count() const { return m_entries.count(); }
+    bool commit();
+    void cancel();
+    QString fileName() const { return m_file.fileName(); }
+    QString errorString() const { return m_sError; }
+
+    static QByteArray fileTypeForPath(const QString& path);
+
+private:
+    bool fail(const QString& error);
+    static bool reject(const QString& reason, QString *error);
+    static QString resourceKey(const QString& resRef, quint16 resType);
+
+    QSaveFile m_file;
+    QByteArray m_fileType;
+    quint32 m_nLanguageCount = 0;
+    QByteArray m_localizedStrings;
+    quint32 m_nDescriptionStrRef = 0xFFFFFFFF;
+    QVector<ErfEntry> m_entries;
+    QSet<QString> m_keys;
+    QString m_sError;
+};
+
+#endif // ERFWRITER_H
@@ -0,0 +1,83 @@
+#include "fixcatalog.h"
+#include <QRegularExpression>
+#include <QVector>
+
+namespace
+{
+struct Category
+{
+    const char *name;
+    const char *pattern;
+};
+
+// One kind per group of CLI options in prolog/last_dirs.pl, the fix lines
+// name the option's subject. First match wins, so the narrower kinds come
+// before the broad ones.
+const Category categories[] = {
+    {"Texture vertices", "\\btverts?\\b|\\btexture vert"}, // tvert_snap
+    {"Snapped vertices", "\\bsnap"},                       // snap
+    {"Pivots", "\\b(re)?pivot"},                           // repivot, move_bad_pivots, pivots_below_z=0
+    {"Split meshes", "\\bsplit"},                          // allow_split, min_Size, split_Priority
+    {"Merged by bitmap", "\\bmerg"},                       // merge_by_bitmap
+    {"Smoothing", "\\bsmooth"},                            // use_Smoothed
+    {"Shadows", "\\bshadows?\\b"},                         // shadow
+    {"Overhangs", "\\boverhangs?\\b"},                     // fix_overhangs
+    {"Walkmesh materials", "\\baabb\\b|\\bwalkmesh"},      // map_aabb_material, map_aabb_from, map_aabb_to
+    {"Tiles", "\\btiles?\\b"},                             // tile_raise, tile_water, tile_ground
+    {"Water", "\\bwater\\b|\\bwaves?\\b"},                 // do_water, dynamic_water, wave_height, rotate_water
+    {"Foliage", "\\bfoliage\\b"},                          // foliage
+    {"Splotches", "\\bsplotch"},                           // splotch
+    {"Ground", "\\bground\\b|\\bchamfer"},                 // rotate_ground, chamfer
+    {"Slices", "\\bslic(e|ed|ing)\\b"},                    // slice, slice_height
+    {"Transparency", "\\btransparen"},                     // placeable_with_transparency
+    {"Invisible meshes", "\\binvisible\\b|\\bcull"},       // invisible_mesh_cull
+    {"Diffuse colour", "\\bwhite\\b|\\bdiffuse\\b"},       // force_white
+    {"Other fixes", "\\b(fixed|repaired|removed|deleted|replaced)\\b"},
+};
+
+// A detail line only reports a fix when it says something was done, lines
+// that merely mention a mesh or an option do not count
+const char *actionPattern = "\\b(fixed|repaired|removed|deleted|replaced|moved|rotated|raised|lowered|"
+                            "merged|split|snapped|culled|sliced|chamfered|smoothed|mapped|whitened|"
+                            "repivoted|turned (on|off))\\b";
+
+const QRegularExpression& action()
+{
+    static const QRegularExpression compiled(actionPattern, QRegularExpression::CaseInsensitiveOption);
+    return compiled;
+}
+
+const QVector<QRegularExpression>& expressions()
+{
+    static const QVector<QRegularExpression> compiled = [] {
+        QVector<QRegularExpression> list;
+        for (const Category &category : categories)
+            list.append(QRegularExpression(category.pattern, QRegularExpression::CaseInsensitiveOption));
+        return list;
+    }();
+    return compiled;
+}
+}
+
+int FixCatalog::categoryCount()
+{
+    return int(sizeof(categories) / sizeof(categories[0]));
+}
+
+QString FixCatalog::categoryName(int category)
+{
+    return QString::fromLatin1(categories[category].name);
+}
+
+int FixCatalog::categorize(const QString& line)
+{
+    if (!action().match(line).hasMatch())
+        return -1;
+    const QVector<QRegularExpression> &list = expressions();
+    for (int i = 0; i < list.count(); ++i)
+    {
+        if (list.at(i).match(line).hasMatch())
+            return i;
+    }
+    return -1;
+}
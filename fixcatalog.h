@@ -0,0 +1,15 @@
+#ifndef FIXCATALOG_H
+#define FIXCATALOG_H
+#include <QString>
+
+// Sorts the detail lines cleanmodels-cli prints while fixing a model into
+// the kinds of faults its options deal with
+namespace FixCatalog
+{
+int categoryCount();
+QString categoryName(int category);
+// Category of a detail line, -1 when it is not about a fix
+int categorize(const QString& line);
+}
+
+#endif // FIXCATALOG_H
@@ -1,73 +1,144 @@
-/****************************************************************************
-**
-** Copyright (C) 2016 The Qt Company Ltd.
-** Contact: https://www.qt.io/licensing/
-**
-** This file is part of the examples of the Qt Toolkit.
-**
-** $QT_BEGIN_LICENSE:BSD$
-** Commercial License Usage
-** Licensees holding valid commercial Qt licenses may use this file in
-** accordance with the commercial license agreement provided with the
-** Software or, alternatively, in accordance with the terms contained in
-** a written agreement between you and The Qt Company. For licensing terms
-** and conditions see https://www.qt.io/terms-conditions. For further
-** information use the contact form at https://www.qt.io/contact-us.
-**
-** BSD License Usage
-** Alternatively, you may use this file under the terms of the BSD license
-** as follows:
-**
-** "Redistribution and use in source and binary forms, with or without
-** modification, are permitted provided that the following conditions are
-** met:
-**   * Redistributions of source code must retain the above copyright
-**     notice, this list of conditions and the following disclaimer.
-**   * Redistributions in binary form must reproduce the above copyright
-**     notice, this list of conditions and the following disclaimer in
-**     the documentation and/or other materials provided with the
-**     distribution.
-**   * Neither the name of The Qt Company Ltd nor the names of its
-**     contributors may be used to endorse or promote products derived
-**     from this software without specific prior written permission.
-**
-**
-** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
-** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
-** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
-** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
-** OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
-** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
-** LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
-** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
-** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
-** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
-** OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
-**
-** $QT_END_LICENSE$
-**
-****************************************************************************/
-
 #include "fsmodel.h"
+#include <QDir>
+#include <QLineEdit>
+#include <QRunnable>
+
+namespace
+{
+// Levels kept at most, a walk through a deep tree starts over past this
+const int MaxCachedLevels = 256;
+}
+
+class DirLevelTask : public QRunnable
+{
+public:
+    DirLevelTask(FileSystemModel *model, const QString& level)
+        : m_pModel(model), m_sLevel(level) {}
+
+    void run() override
+    {
+        QStringList paths;
+        if (m_sLevel.isEmpty())
+        {
+            // Nothing typed yet, offer the drives where there are some
+            for (const QFileInfo &drive : QDir::drives())
+            {
+                QString path = QDir::toNativeSeparators(drive.absoluteFilePath());
+                if (path.length() > 1 && path.endsWith(QDir::separator()))
+                    path.chop(1);
+                paths.append(path);
+            }
+        }
+        else
+        {
+            const QStringList names = QDir(QDir::fromNativeSeparators(m_sLevel)).entryList(
+                        QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name | QDir::IgnoreCase);
+            paths.reserve(names.count());
+            for (const QString &name : names)
+                paths.append(m_sLevel + name);
+        }
+        FileSystemModel *model = m_pModel;
+        const QString level = m_sLevel;
+        QMetaObject::invokeMethod(model, [model, level, paths]() {
+            model->levelListed(level, paths);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    FileSystemModel *m_pModel;
+    QString m_sLevel;
+};
 
-//! [0]
 FileSystemModel::FileSystemModel(QObject *parent)
-    : QFileSystemModel(parent)
+    : QAbstractListModel(parent)
+{
+    // Slow mounts hold their thread, the next level need not wait for them
+    m_pool.setMaxThreadCount(2);
+}
+
+FileSystemModel::~FileSystemModel()
 {
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+int FileSystemModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_paths.count();
 }
-//! [0]
 
-//! [1]
 QVariant FileSystemModel::data(const QModelIndex &index, int role) const
 {
-    if (role == Qt::DisplayRole && index.column() == 0) {
-        QString path  = QDir::toNativeSeparators(filePath(index));
-        if (path.endsWith(QDir::separator()))
-            path.chop(1);
-        return path;
+    if (!index.isValid() || index.row() >= m_paths.count())
+        return QVariant();
+    if (role == Qt::DisplayRole || role == Qt::EditRole)
+        return m_paths.at(index.row());
+    return QVariant();
+}
+
+QString FileSystemModel::levelOf(const QString& path)
+{
+    const int separator = qMax(path.lastIndexOf('/'), path.lastIndexOf('\\'));
+    return path.left(separator + 1);
+}
+
+void FileSystemModel::setLevel(const QString& level)
+{
+    if (level == m_sLevel)
+        return;
+    m_sLevel = level;
+    beginResetModel();
+    m_paths = m_cache.value(level);
+    endResetModel();
+    if (!m_paths.isEmpty())
+        emit levelReady(level);
+    if (!m_pending.contains(level))
+    {
+        m_pending.insert(level);
+        m_pool.start(new DirLevelTask(this, level));
     }
+}
+
+void FileSystemModel::levelListed(const QString& level, const QStringList& paths)
+{
+    m_pending.remove(level);
+    if (m_cache.count() >= MaxCachedLevels && !m_cache.contains(level))
+        m_cache.clear();
+    m_cache.insert(level, paths);
+    if (level != m_sLevel || paths == m_paths)
+        return;
+    beginResetModel();
+    m_paths = paths;
+    endResetModel();
+    emit levelReady(level);
+}
+
+DirCompleter::DirCompleter(QObject *parent)
+    : QCompleter(parent)
+    , m_pModel(new FileSystemModel(this))
+{
+    setModel(m_pModel);
+    setModelSorting(QCompleter::CaseInsensitivelySortedModel);
+    setCaseSensitivity(Qt::CaseInsensitive);
+    connect(m_pModel, &FileSystemModel::levelReady, this, &DirCompleter::onLevelReady);
+}
 
-    return QFileSystemModel::data(index, role);
+QStringList DirCompleter::splitPath(const QString& path) const
+{
+    // The model is not switched while the completer filters it
+    const QString level = FileSystemModel::levelOf(path);
+    if (level != m_pModel->level())
+    {
+        FileSystemModel *model = m_pModel;
+        QMetaObject::invokeMethod(model, [model, level]() { model->setLevel(level); }, Qt::QueuedConnection);
+    }
+    return QStringList(path);
 }
 
-//! [1]
+void DirCompleter::onLevelReady(const QString& level)
+{
+    // Suggestions that arrive after the keystroke are shown all the same
+    auto *edit = qobject_cast<QLineEdit*>(widget());
+    if (edit && edit->hasFocus() && FileSystemModel::levelOf(edit->text()) == level)
+        complete();
+}
@@ -1,70 +1,63 @@
-/****************************************************************************
-**
-** Copyright (C) 2016 The Qt Company Ltd.
-** Contact: https://www.qt.io/licensing/
-**
-** This file is part of the examples of the Qt Toolkit.
-**
-** $QT_BEGIN_LICENSE:BSD$
-** Commercial License Usage
-** Licensees holding valid commercial Qt licenses may use this file in
-** accordance with the commercial license agreement provided with the
-** Software or, alternatively, in accordance with the terms contained in
-** a written agreement between you and The Qt Company. For licensing terms
-** and conditions see https://www.qt.io/terms-conditions. For further
-** information use the contact form at https://www.qt.io/contact-us.
-**
-** BSD License Usage
-** Alternatively, you may use this file under the terms of the BSD license
-** as follows:
-**
-** "Redistribution and use in source and binary forms, with or without
-** modification, are permitted provided that the following conditions are
-** met:
-**   * Redistributions of source code must retain the above copyright
-**     notice, this list of conditions and the following disclaimer.
-**   * Redistributions in binary form must reproduce the above copyright
-**     notice, this list of conditions and the following disclaimer in
-**     the documentation and/or other materials provided with the
-**     distribution.
-**   * Neither the name of The Qt Company Ltd nor the names of its
-**     contributors may be used to endorse or promote products derived
-**     from this software without specific prior written permission.
-**
-**
-** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
-** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
-** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
-** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
-** OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
-** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
-** LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
-** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
-** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
-** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
-** OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
-**
-** $QT_END_LICENSE$
-**
-****************************************************************************/
-
 #ifndef FILESYSTEMMODEL_H
 #define FILESYSTEMMODEL_H
+#include <QAbstractListModel>
+#include <QCompleter>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QThreadPool>
 
-#include <QFileSystemModel>
-
-// With a QFileSystemModel, set on a view, you will see "Program Files" in the view
-// But with this model, you will see "C:\Program Files" in the view.
-// We achieve this, by having the data() return the entire file path for
-// the display role. Note that the Qt::EditRole over which the QCompleter
-// looks for matches is left unchanged
-//! [0]
-class FileSystemModel : public QFileSystemModel
+// Directory suggestions for the path fields. Only the level being typed is
+// listed, on a worker thread, and every level listed keeps its paths ready
+// formatted, so neither typing nor startup waits on the file system.
+class FileSystemModel : public QAbstractListModel
 {
+    Q_OBJECT
+
 public:
-    FileSystemModel(QObject *parent = nullptr);
+    explicit FileSystemModel(QObject *parent = nullptr);
+    ~FileSystemModel() override;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    // Shows the folders in level, the text up to and including the last
+    // separator. A cached level shows at once and is listed again behind it.
+    void setLevel(const QString& level);
+    QString level() const { return m_sLevel; }
+
+    static QString levelOf(const QString& path);
+
+signals:
+    void levelReady(const QString& level);
+
+private:
+    friend class DirLevelTask;
+
+    void levelListed(const QString& level, const QStringList& paths);
+
+    QString m_sLevel;
+    QStringList m_paths;
+    QHash<QString, QStringList> m_cache;
+    QSet<QString> m_pending;
+    QThreadPool m_pool;
+};
+
+// Completes folders through a FileSystemModel, following the level of
+// whatever the focused field holds
+class DirCompleter : public QCompleter
+{
+    Q_OBJECT
+
+public:
+    explicit DirCompleter(QObject *parent = nullptr);
+
+    QStringList splitPath(const QString& path) const override;
+
+private:
+    void onLevelReady(const QString& level);
+
+    FileSystemModel *m_pModel;
 };
-//! [0]
 
 #endif
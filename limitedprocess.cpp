@@ -0,0 +1,95 @@
+#include "limitedprocess.h"
+#include <QStringList>
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <sched.h>
+#endif
+
+QVector<int> ProcessLimits::parseCpuList(const QString& list)
+{
+    QVector<int> cpus;
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 2))
+    const QStringList ranges = list.split(',', Qt::SkipEmptyParts);
+#else
+    const QStringList ranges = list.split(',', QString::SkipEmptyParts);
+#endif
+    for (const QString &range : ranges)
+    {
+        const QStringList bounds = range.trimmed().split('-');
+        bool firstOk = false;
+        bool lastOk = false;
+        const int first = bounds.first().toInt(&firstOk);
+        const int last = bounds.size() > 1 ? bounds.at(1).toInt(&lastOk) : first;
+        if (!firstOk || (bounds.size() > 1 && !lastOk) || first < 0 || last < first)
+            continue;
+        for (int cpu = first; cpu <= qMin(last, 1023); ++cpu)
+        {
+            if (!cpus.contains(cpu))
+                cpus.append(cpu);
+        }
+    }
+    return cpus;
+}
+
+LimitedProcess::LimitedProcess(const ProcessLimits& limits, QObject *parent) :
+    QProcess(parent),
+    m_limits(limits)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0) && defined(Q_OS_UNIX)
+    setChildProcessModifier([this]() { applyLimits(); });
+#endif
+}
+
+bool LimitedProcess::isSupported()
+{
+#ifdef Q_OS_UNIX
+    return true;
+#else
+    return false;
+#endif
+}
+
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+void LimitedProcess::setupChildProcess()
+{
+    applyLimits();
+}
+#endif
+
+// Runs in the forked child, so nothing in here may allocate
+void LimitedProcess::applyLimits() const
+{
+#ifdef Q_OS_UNIX
+    if (m_limits.addressSpaceMB > 0)
+    {
+        struct rlimit limit;
+        limit.rlim_cur = limit.rlim_max = rlim_t(m_limits.addressSpaceMB) * 1024 * 1024;
+        setrlimit(RLIMIT_AS, &limit);
+    }
+    if (m_limits.cpuSeconds > 0)
+    {
+        // The soft limit sends SIGXCPU, the hard one a second later SIGKILL
+        struct rlimit limit;
+        limit.rlim_cur = rlim_t(m_limits.cpuSeconds);
+        limit.rlim_max = rlim_t(m_limits.cpuSeconds) + 1;
+        setrlimit(RLIMIT_CPU, &limit);
+    }
+    if (m_limits.niceLevel)
+        setpriority(PRIO_PROCESS, 0, m_limits.niceLevel);
+#endif
+#ifdef Q_OS_LINUX
+    if (!m_limits.cpus.isEmpty())
+    {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        for (int cpu : m_limits.cpus)
+        {
+            if (cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &cpuSet);
+        }
+        sched_setaffinity(0, sizeof(cpuSet), &cpuSet);
+    }
+#endif
+}
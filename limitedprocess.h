@@ -0,0 +1,40 @@
+#ifndef LIMITEDPROCESS_H
+#define LIMITEDPROCESS_H
+#include <QProcess>
+#include <QVector>
+
+struct ProcessLimits
+{
+    qint64 addressSpaceMB = 0; // 0 for no limit
+    int cpuSeconds = 0; // 0 for no limit
+    int niceLevel = 0;
+    QVector<int> cpus; // empty to run on any CPU
+
+    bool isEmpty() const { return !addressSpaceMB && !cpuSeconds && !niceLevel && cpus.isEmpty(); }
+    // "0-3,6" style lists as used by taskset
+    static QVector<int> parseCpuList(const QString& list);
+};
+
+// A QProcess whose child applies resource limits, a nice level and CPU
+// pinning before it executes. Limits are only applied on Unix systems.
+class LimitedProcess : public QProcess
+{
+    Q_OBJECT
+
+public:
+    explicit LimitedProcess(const ProcessLimits& limits, QObject *parent = nullptr);
+
+    static bool isSupported();
+
+protected:
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    void setupChildProcess() override;
+#endif
+
+private:
+    void applyLimits() const;
+
+    ProcessLimits m_limits;
+};
+
+#endif // LIMITEDPROCESS_H
@@ -0,0 +1,75 @@
+#include "loadmonitor.h"
+#include <QFile>
+#include <QList>
+#include <QString>
+
+namespace
+{
+QByteArray readProcFile(const QString& path)
+{
+    // Files in /proc report a size of zero, so read until the end
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return file.readAll();
+}
+
+// Value in kB of a "Key:   1234 kB" line
+qint64 keyedValueKb(const QByteArray& text, const QByteArray& key)
+{
+    int pos = text.startsWith(key) ? 0 : text.indexOf("\n" + key);
+    if (pos < 0)
+        return -1;
+    if (text.at(pos) == '\n')
+        ++pos;
+    pos += key.size();
+    int lineEnd = text.indexOf('\n', pos);
+    const QList<QByteArray> fields = text.mid(pos, lineEnd < 0 ? -1 : lineEnd - pos).simplified().split(' ');
+    return fields.isEmpty() ? -1 : fields.first().toLongLong();
+}
+}
+
+LoadSample LoadMonitor::sample()
+{
+    LoadSample load;
+#ifdef Q_OS_LINUX
+    // First line of /proc/stat: cpu user nice system idle iowait irq softirq steal
+    const QByteArray stat = readProcFile("/proc/stat");
+    const QList<QByteArray> cpu = stat.left(stat.indexOf('\n')).simplified().split(' ');
+    if (cpu.size() < 6 || cpu.first() != "cpu")
+        return load;
+    quint64 total = 0;
+    for (int i = 1; i < qMin(cpu.size(), 9); ++i)
+        total += cpu.at(i).toULongLong();
+    const quint64 idle = cpu.at(4).toULongLong() + cpu.at(5).toULongLong();
+    if (m_nPrevTotal && total > m_nPrevTotal)
+        load.cpuBusy = 1.0 - double(idle - m_nPrevIdle) / double(total - m_nPrevTotal);
+    m_nPrevTotal = total;
+    m_nPrevIdle = idle;
+
+    const QByteArray meminfo = readProcFile("/proc/meminfo");
+    load.memTotalKb = keyedValueKb(meminfo, "MemTotal:");
+    load.memAvailableKb = keyedValueKb(meminfo, "MemAvailable:");
+    if (load.memTotalKb <= 0 || load.memAvailableKb < 0)
+        return load;
+
+    // Pressure stall information, only on kernels built with PSI
+    const QByteArray pressure = readProcFile("/proc/pressure/io");
+    const int avg10 = pressure.indexOf("avg10=");
+    if (pressure.startsWith("some") && avg10 >= 0)
+        load.ioPressure = pressure.mid(avg10 + 6, pressure.indexOf(' ', avg10) - avg10 - 6).toDouble();
+    load.valid = true;
+#endif
+    return load;
+}
+
+qint64 LoadMonitor::residentKb(qint64 pid)
+{
+#ifdef Q_OS_LINUX
+    if (pid > 0)
+        return qMax<qint64>(0, keyedValueKb(readProcFile(QString("/proc/%1/status").arg(pid)), "VmRSS:"));
+#else
+    Q_UNUSED(pid)
+#endif
+    return 0;
+}
@@ -0,0 +1,27 @@
+#ifndef LOADMONITOR_H
+#define LOADMONITOR_H
+#include <QtGlobal>
+
+struct LoadSample
+{
+    bool valid = false;
+    double cpuBusy = 0.0; // share of all cores busy since the previous sample
+    qint64 memTotalKb = 0;
+    qint64 memAvailableKb = 0;
+    double ioPressure = -1.0; // percentage of time stalled on I/O, -1 when unknown
+};
+
+// Reads system load from /proc. Everywhere else the samples come back
+// invalid and callers keep their fixed limits.
+class LoadMonitor
+{
+public:
+    LoadSample sample();
+    static qint64 residentKb(qint64 pid);
+
+private:
+    quint64 m_nPrevTotal = 0;
+    quint64 m_nPrevIdle = 0;
+};
+
+#endif // LOADMONITOR_H
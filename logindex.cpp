@@ -0,0 +1,81 @@
+#include "logindex.h"
+#include <algorithm>
+#include <iterator>
+
+QStringList LogIndex::words(const QString& text)
+{
+    // Runs of letters, digits and underscores, case folded
+    QStringList words;
+    int start = -1;
+    for (int i = 0; i <= text.size(); ++i)
+    {
+        const bool wordChar = i < text.size() && (text.at(i).isLetterOrNumber() || text.at(i) == '_');
+        if (wordChar && start < 0)
+            start = i;
+        else if (!wordChar && start >= 0)
+        {
+            words.append(text.mid(start, i - start).toLower());
+            start = -1;
+        }
+    }
+    return words;
+}
+
+void LogIndex::addLine(int jobId, const QString& model, Severity severity, const QString& text)
+{
+    const int index = m_lines.count();
+    Line line;
+    line.jobId = jobId;
+    line.model = model;
+    line.severity = severity;
+    line.text = text;
+    m_lines.append(line);
+    QStringList lineWords = words(text) + words(model);
+    lineWords.removeDuplicates();
+    for (const QString &word : qAsConst(lineWords))
+        m_postings[word].append(index);
+}
+
+QVector<int> LogIndex::search(const QString& query, int severities, int limit) const
+{
+    QVector<int> matches;
+    QStringList queryWords = words(query);
+    queryWords.removeDuplicates();
+    if (queryWords.isEmpty())
+    {
+        for (int i = 0; i < m_lines.count() && matches.count() < limit; ++i)
+        {
+            if (m_lines.at(i).severity & severities)
+                matches.append(i);
+        }
+        return matches;
+    }
+    QVector<const QVector<int>*> postings;
+    for (const QString &word : qAsConst(queryWords))
+    {
+        auto it = m_postings.constFind(word);
+        if (it == m_postings.constEnd())
+            return matches;
+        postings.append(&it.value());
+    }
+    // Start from the rarest word, the candidates only ever shrink
+    std::sort(postings.begin(), postings.end(), [](const QVector<int> *a, const QVector<int> *b) {
+        return a->count() < b->count();
+    });
+    QVector<int> candidates = *postings.first();
+    for (int i = 1; i < postings.count() && !candidates.isEmpty(); ++i)
+    {
+        QVector<int> kept;
+        std::set_intersection(candidates.constBegin(), candidates.constEnd(),
+                              postings.at(i)->constBegin(), postings.at(i)->constEnd(), std::back_inserter(kept));
+        candidates = kept;
+    }
+    for (int index : qAsConst(candidates))
+    {
+        if (matches.count() >= limit)
+            break;
+        if (m_lines.at(index).severity & severities)
+            matches.append(index);
+    }
+    return matches;
+}
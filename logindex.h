@@ -0,0 +1,43 @@
+#ifndef LOGINDEX_H
+#define LOGINDEX_H
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Inverted index over the worker output of every job, filled line by line as
+// the output is parsed. A search looks up the posting list of every word and
+// intersects them, it never scans the lines themselves.
+class LogIndex
+{
+public:
+    enum Severity
+    {
+        Error = 1,
+        Written = 2,
+        Read = 4,
+        Other = 8,
+        AnySeverity = Error | Written | Read | Other
+    };
+
+    struct Line
+    {
+        int jobId = 0;
+        QString model;
+        Severity severity = Other;
+        QString text;
+    };
+
+    void addLine(int jobId, const QString& model, Severity severity, const QString& text);
+    // Lines holding every word of the query, oldest first
+    QVector<int> search(const QString& query, int severities, int limit) const;
+    const Line& line(int index) const { return m_lines.at(index); }
+    int count() const { return m_lines.count(); }
+    static QStringList words(const QString& text);
+
+private:
+    QVector<Line> m_lines;
+    QHash<QString, QVector<int>> m_postings; // word -> lines, ascending
+};
+
+#endif // LOGINDEX_H
@@ -1,12 +1,29 @@
 #include "mainwindow.h"
 #include <QApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
 int main(int argc, char *argv[])
 {
+    QElapsedTimer startup;
+    startup.start();
     QApplication a(argc, argv);
     QCoreApplication::setOrganizationName("Clean Models Community");
     QCoreApplication::setApplicationName("Clean Models::EE QT");
     QCoreApplication::setApplicationVersion(QT_VERSION_STR);
     MainWindow w;
+
+    // CLEANMODELS_STARTUP_BENCHMARK prints how long the window took to show
+    // its first frame and to become interactive, then quits
+    qint64 firstFrameMs = -1;
+    if (qEnvironmentVariableIsSet("CLEANMODELS_STARTUP_BENCHMARK"))
+    {
+        QObject::connect(&w, &MainWindow::firstFramePainted, [&]() { firstFrameMs = startup.elapsed(); });
+        QObject::connect(&w, &MainWindow::startupFinished, [&]() {
+            QTextStream(stdout) << "time to first frame: " << firstFrameMs << " ms\n"
+                                << "time to interactive: " << startup.elapsed() << " ms\n";
+            QTimer::singleShot(0, &a, &QCoreApplication::quit);
+        });
+    }
     w.show();
 
     return QApplication::exec();
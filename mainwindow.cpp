@@ -1,27 +1,75 @@
 ﻿#include "fsmodel.h"
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "remoteprotocol.h"
+#include "resultsbrowser.h"
+#include "resultsproxy.h"
 #include <QApplication>
 #include <QClipboard>
 #include <QCompleter>
+#include <QDateTime>
 #include <QDebug>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QDir>
 #include <QFile>
 #include <QFileDialog>
 #include <QFileInfo>
+#include <QFormLayout>
+#include <QLineEdit>
 #include <QMessageBox>
+#include <QPlainTextEdit>
 #include <QProgressBar>
+#include <QRegularExpression>
+#include <QRunnable>
 #include <QScreen>
 #include <QScrollBar>
 #include <QSettings>
+#include <QSpinBox>
 #include <QStandardPaths>
 #include <QStringBuilder>
 #include <QTableWidgetItem>
 #include <QTextStream>
+#include <QThread>
 #include <QWhatsThis>
 #include <QWindow>
 
 using namespace std;
 
+namespace
+{
+// Looks for the CLI off the GUI thread and reports it with the time it was
+// built, the CLI has no option that prints its version
+class CliProbeTask : public QRunnable
+{
+public:
+    CliProbeTask(QObject *window, const QString& binaryName)
+        : m_pWindow(window), m_sBinaryName(binaryName) {}
+
+    void run() override
+    {
+        // CLEANMODELS_CLI points at another build of the CLI or at the worker stub
+        QString cliInPath = QFile::decodeName(qgetenv("CLEANMODELS_CLI"));
+        if (!cliInPath.isEmpty() && !QFileInfo(cliInPath).isExecutable())
+            cliInPath.clear();
+        if (cliInPath.isEmpty())
+            cliInPath = QStandardPaths::findExecutable(m_sBinaryName);
+        if (cliInPath.isEmpty())
+        {
+            QStringList cliPaths = {QDir::currentPath(), QCoreApplication::applicationDirPath()};
+            cliInPath = QStandardPaths::findExecutable(m_sBinaryName, cliPaths);
+        }
+        const QDateTime built = cliInPath.isEmpty() ? QDateTime() : QFileInfo(cliInPath).lastModified();
+        QMetaObject::invokeMethod(m_pWindow, "onCliProbed", Qt::QueuedConnection,
+                                  Q_ARG(QString, cliInPath), Q_ARG(QDateTime, built));
+    }
+
+private:
+    QObject *m_pWindow;
+    QString m_sBinaryName;
+};
+}
+
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow)
@@ -35,44 +83,13 @@ MainWindow::MainWindow(QWidget *parent) :
     m_sBinaryName = "cleanmodels-cli";
 #endif
 
-    bool cliFound = true;
-    auto cliInPath = QStandardPaths::findExecutable(m_sBinaryName);
-    if (cliInPath.isEmpty())
-    {
-        QStringList cliPaths = {QDir::currentPath(), QApplication::applicationDirPath()};
-        cliInPath = QStandardPaths::findExecutable(m_sBinaryName, cliPaths);
-        if (cliInPath.isEmpty())
-            cliFound = false;
-    }
-
-    if (cliFound)
-    {
-        m_sBinaryPath = cliInPath;
-        QString foundMsg = "Clean Models Command Line Interface found at " % m_sBinaryPath;
-        ui->debugTextBrowser->insertHtml(tr(foundMsg.toStdString().c_str()));
-        auto sb = ui->debugTextBrowser->verticalScrollBar();
-        sb->setValue(sb->maximum());
-    }
-    else
-    {
-        QString errorMsg = "Could not find the " % m_sBinaryName % " executable in the current directory or in your path!";
-        QMessageBox::critical(nullptr, "No cleanmodels-cli", tr(errorMsg.toStdString().c_str()));
-        ui->debugTextBrowser->insertHtml(tr(errorMsg.toStdString().c_str()));
-        auto sb = ui->debugTextBrowser->verticalScrollBar();
-        sb->setValue(sb->maximum());
-    }
+    // Searching the path can stall on network drives, the window comes up
+    // while the CLI is looked for
+    m_probePool.setMaxThreadCount(1);
+    m_probePool.start(new CliProbeTask(this, m_sBinaryName));
 
-    m_pCleanProcess = new QProcess(this);
     m_bCleanRunning = false;
     m_sLastDirsPath = QCoreApplication::applicationDirPath() % "/last_dirs.pl";
-    bool fileExists = QFileInfo::exists(m_sLastDirsPath) && QFileInfo(m_sLastDirsPath).isFile();
-    if (!fileExists)
-    {
-        QFile fromResource(":/last_dirs.pl");
-        fromResource.copy(m_sLastDirsPath);
-        QFile out(m_sLastDirsPath);
-        out.setPermissions(QFileDevice::ReadOwner | QFileDevice::ReadGroup | QFileDevice::ReadOther | QFileDevice::WriteOwner | QFileDevice::WriteGroup);
-    }
 
     auto* sStatusLabel = new QLabel( QString( tr("Status:") ) );
     m_pCleanStatus = new QLabel( QString( tr("Idle") ) );
@@ -87,28 +104,52 @@ MainWindow::MainWindow(QWidget *parent) :
     statusBar()->addPermanentWidget( sStatusLabel );
     statusBar()->addPermanentWidget( m_pCleanStatus );
 
-    m_pDirCompleter = new QCompleter(this);
+    m_pDirCompleter = new DirCompleter(this);
     m_pDirCompleter->setMaxVisibleItems(4);
-    m_pFileSystemModel = new FileSystemModel(m_pDirCompleter);
-    m_pFileSystemModel->setFilter(QDir::Dirs|QDir::Drives|QDir::NoDotAndDotDot|QDir::AllDirs);
-    m_pDirCompleter->setModel(m_pFileSystemModel);
     ui->inDirectory->setCompleter(m_pDirCompleter);
     ui->outDirectory->setCompleter(m_pDirCompleter);
 
-    ui->filesTable->setColumnCount(5);
-    ui->filesTable->setColumnWidth(1, 100);
-    ui->filesTable->setColumnWidth(2, 140);
-    ui->filesTable->setColumnWidth(3, 70);
-    ui->filesTable->setColumnWidth(4, 100);
-    ui->filesTable->setHorizontalHeaderLabels({"File", "Size", "Status", "Fixes", "Time"});
-    ui->filesTable->setAlternatingRowColors(true);
-    ui->filesTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
-    ui->filesTable->horizontalHeader()->setVisible(true);
-    ui->filesTable->verticalHeader()->setDefaultSectionSize(20);
-    ui->filesTable->verticalHeader()->setVisible(false);
-    ui->filesTable->setContextMenuPolicy(Qt::CustomContextMenu);
-    ui->filesTable->setSelectionMode(QAbstractItemView::SingleSelection);
-    ui->filesTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    ResultsBrowser *filesBrowser = setupResultsTable(ui->filesTable);
+    connect(filesBrowser, &ResultsBrowser::contextMenuRequested, this, &MainWindow::onFilesContextMenu);
+    connect(filesBrowser, &ResultsBrowser::rowDoubleClicked, this, &MainWindow::onFilesRowDoubleClicked);
+
+    ui->jobsTable->setColumnWidth(0, 120);
+    ui->jobsTable->setColumnWidth(3, 60);
+    ui->jobsTable->setColumnWidth(4, 80);
+    ui->jobsTable->setColumnWidth(5, 140);
+    ui->jobsTable->horizontalHeader()->setSectionResizeMode(1, QHeaderView::Stretch);
+    ui->jobsTable->horizontalHeader()->setSectionResizeMode(2, QHeaderView::Stretch);
+    ui->jobsTable->verticalHeader()->setDefaultSectionSize(24);
+    ui->menuRun->addSeparator();
+    ui->menuRun->addAction(ui->jobsDock->toggleViewAction());
+    ui->menuRun->addAction(ui->logSearchDock->toggleViewAction());
+    ui->logSearchTable->setColumnWidth(0, 100);
+    ui->logSearchTable->setColumnWidth(1, 200);
+    ui->logSearchTable->setColumnWidth(2, 70);
+    ui->logSearchTable->horizontalHeader()->setStretchLastSection(true);
+
+    {
+        QSettings settings(QCoreApplication::organizationName(), QCoreApplication::applicationName());
+        QSignalBlocker blockRecursive(ui->recursiveCheck);
+        ui->recursiveCheck->setChecked(settings.value("recursive", false).toBool());
+        QSignalBlocker blockDedupe(ui->dedupeCheck);
+        ui->dedupeCheck->setChecked(settings.value("dedupe", true).toBool());
+        const int cores = qMax(1, QThread::idealThreadCount());
+        ui->decompileWorkersSpin->setMaximum(cores);
+        ui->cleanWorkersSpin->setMaximum(cores);
+        QSignalBlocker blockDecompileWorkers(ui->decompileWorkersSpin);
+        ui->decompileWorkersSpin->setValue(settings.value("decompileWorkers", qMax(1, cores / 4)).toInt());
+        QSignalBlocker blockCleanWorkers(ui->cleanWorkersSpin);
+        ui->cleanWorkersSpin->setValue(settings.value("cleanWorkers", qMax(1, cores / 2)).toInt());
+        QSignalBlocker blockAdaptive(ui->adaptiveWorkersCheck);
+        ui->adaptiveWorkersCheck->setChecked(settings.value("adaptiveWorkers", true).toBool());
+        QSignalBlocker blockMemoryCeiling(ui->memoryCeilingSpin);
+        ui->memoryCeilingSpin->setValue(settings.value("memoryCeilingMB", 0).toInt());
+        QSignalBlocker blockPersistent(ui->actionPersistentWorkers);
+        ui->actionPersistentWorkers->setChecked(settings.value("persistentWorkers", false).toBool());
+        QSignalBlocker blockWatch(ui->actionWatchMode);
+        ui->actionWatchMode->setChecked(settings.value("watchMode", false).toBool());
+    }
 
     m_iconReadingMDL = QIcon(":icons/reading-mdl");
     m_iconDecompilingMDL = QIcon(":icons/decompiling-mdl");
@@ -133,23 +174,62 @@ MainWindow::MainWindow(QWidget *parent) :
     m_dirWatcherTimer->setInterval(500);
     connect(m_dirWatcherTimer, &QTimer::timeout, this, QOverload<>::of(&MainWindow::handleDirWatcherTimer));
     m_bUpdateFilesAfterClean = false;
-
-    readInLastDirs(m_sLastDirsPath);
-    QObject::connect(m_pCleanProcess, static_cast<void(QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished), this, &MainWindow::onCleanFinished);
+    m_pLoadTimer = new QTimer(this);
+    m_pLoadTimer->setInterval(1000);
+    connect(m_pLoadTimer, &QTimer::timeout, this, &MainWindow::onLoadSampleTimer);
+    setupMetrics();
+    m_pWatchTimer = new QTimer(this);
+    m_pWatchTimer->setInterval(1000);
+    connect(m_pWatchTimer, &QTimer::timeout, this, &MainWindow::onWatchTimer);
+
+    m_pCommitter = new OutputCommitter(this);
+    m_pPrefetcher = new Prefetcher(this);
+    QObject::connect(m_pCommitter, &OutputCommitter::committed, this, &MainWindow::onModelCommitted);
     QObject::connect(ui->actionHelp, SIGNAL(triggered()), this, SLOT(onHelpTriggered()));
     QObject::connect(ui->actionAbout, SIGNAL(triggered()), this, SLOT(onAboutTriggered()));
     QObject::connect(ui->actionSavePreset, SIGNAL(triggered()), this, SLOT(onSaveConfigTriggered()));
     QObject::connect(ui->actionLoadPreset, SIGNAL(triggered()), this, SLOT(onLoadConfigTriggered()));
     QObject::connect(ui->actionQuit, SIGNAL(triggered()), this, SLOT(onQuitTriggered()));
-    QObject::connect(&m_fsWatcher, SIGNAL(directoryChanged(QString)), this, SLOT(onDirectoryContentsChanged()));
+    QObject::connect(ui->actionWorkerLimits, SIGNAL(triggered()), this, SLOT(onWorkerLimitsTriggered()));
+    QObject::connect(ui->actionRemoteAgents, SIGNAL(triggered()), this, SLOT(onRemoteAgentsTriggered()));
+    QObject::connect(ui->actionPause, SIGNAL(toggled(bool)), this, SLOT(onPauseToggled(bool)));
+    QObject::connect(ui->actionPersistentWorkers, SIGNAL(toggled(bool)), this, SLOT(onPersistentWorkersToggled(bool)));
+    QObject::connect(ui->actionWatchMode, SIGNAL(toggled(bool)), this, SLOT(onWatchModeToggled(bool)));
+    QObject::connect(ui->actionFixBreakdown, SIGNAL(triggered()), this, SLOT(onFixBreakdownTriggered()));
+    QObject::connect(ui->actionRenderCost, SIGNAL(triggered()), this, SLOT(onRenderCostTriggered()));
+    QObject::connect(ui->actionOpenArchive, SIGNAL(triggered()), this, SLOT(onOpenArchiveTriggered()));
+    QObject::connect(ui->actionOutputArchive, SIGNAL(triggered()), this, SLOT(onOutputArchiveTriggered()));
+    QObject::connect(&m_fsWatcher, SIGNAL(directoryChanged(QString)), this, SLOT(onDirectoryContentsChanged(QString)));
+    QObject::connect(&m_fsWatcher, SIGNAL(fileChanged(QString)), this, SLOT(onDirectoryContentsChanged(QString)));
     readSettings();
 }
 
 MainWindow::~MainWindow()
 {
+    m_probePool.waitForDone();
+    stopDuplicateScan();
+    stopStatsScan();
+    for (CleanWorker *worker : qAsConst(m_workers))
+    {
+        worker->process->disconnect(this);
+        worker->process->kill();
+        worker->process->waitForFinished();
+    }
+    qDeleteAll(m_workers);
+    m_pCommitter->waitForDone();
+    for (CleanJob *job : qAsConst(m_jobs))
+    {
+        delete job->walker;
+        delete job->scanner;
+        delete job->outArchive;
+        delete job->inArchive;
+        delete job->stageDir;
+        delete job->selectionDir;
+        delete job->runDir;
+    }
+    qDeleteAll(m_jobs);
+    delete m_pInArchive;
     delete ui;
-    m_pCleanProcess->close();
-    delete m_pCleanProcess;
 }
 
 // Window Position/Geometry
@@ -174,12 +254,14 @@ void MainWindow::readSettings()
     {
         restoreGeometry(geometry);
     }
+    restoreState(settings.value("windowState", QByteArray()).toByteArray());
 }
 
 void MainWindow::writeSettings()
 {
     QSettings settings(QCoreApplication::organizationName(), QCoreApplication::applicationName());
     settings.setValue("geometry", saveGeometry());
+    settings.setValue("windowState", saveState());
 }
 
 void MainWindow::closeEvent(QCloseEvent*)
@@ -187,6 +269,71 @@ void MainWindow::closeEvent(QCloseEvent*)
     writeSettings();
 }
 
+void MainWindow::paintEvent(QPaintEvent *event)
+{
+    QMainWindow::paintEvent(event);
+    if (m_bFirstFramePainted)
+        return;
+    m_bFirstFramePainted = true;
+    emit firstFramePainted();
+    // What the first frame can do without is done once it is up
+    QTimer::singleShot(0, this, &MainWindow::finishStartup);
+}
+
+void MainWindow::finishStartup()
+{
+    bool fileExists = QFileInfo::exists(m_sLastDirsPath) && QFileInfo(m_sLastDirsPath).isFile();
+    if (!fileExists)
+    {
+        QFile fromResource(":/last_dirs.pl");
+        fromResource.copy(m_sLastDirsPath);
+        QFile out(m_sLastDirsPath);
+        out.setPermissions(QFileDevice::ReadOwner | QFileDevice::ReadGroup | QFileDevice::ReadOther | QFileDevice::WriteOwner | QFileDevice::WriteGroup);
+    }
+    // The first listing runs on the walker's threads, the window counts as
+    // interactive once it is shown
+    m_bAwaitingFirstListing = true;
+    readInLastDirs(m_sLastDirsPath);
+    if (ui->actionWatchMode->isChecked())
+        startWatching();
+    if (m_bAwaitingFirstListing && !m_pDirWalker)
+    {
+        m_bAwaitingFirstListing = false;
+        startupStepDone();
+    }
+}
+
+void MainWindow::startupStepDone()
+{
+    if (--m_nStartupSteps == 0)
+        emit startupFinished();
+}
+
+void MainWindow::onCliProbed(const QString& path, const QDateTime& built)
+{
+    m_bProbingCli = false;
+    if (!path.isEmpty())
+    {
+        m_sBinaryPath = path;
+        QString foundMsg = "Clean Models Command Line Interface found at " % m_sBinaryPath;
+        if (built.isValid())
+            foundMsg += " (" % built.toString(Qt::ISODate) % ")";
+        appendLog(ui->debugTextBrowser, tr(foundMsg.toStdString().c_str()));
+    }
+    else
+    {
+        QString errorMsg = "Could not find the " % m_sBinaryName % " executable in the current directory or in your path!";
+        appendLog(ui->debugTextBrowser, tr(errorMsg.toStdString().c_str()));
+        // The window is interactive before the dialog, and a benchmark run
+        // has nobody to close it
+        startupStepDone();
+        if (!qEnvironmentVariableIsSet("CLEANMODELS_STARTUP_BENCHMARK"))
+            QMessageBox::critical(this, "No cleanmodels-cli", tr(errorMsg.toStdString().c_str()));
+        return;
+    }
+    startupStepDone();
+}
+
 // Main last_dirs parsing and writing functions
 void MainWindow::readInLastDirs(const QString& fileLoc)
 {
@@ -215,15 +362,11 @@ void MainWindow::readInLastDirs(const QString& fileLoc)
               if (captured == "g_indir")
               {
                   onUpdateInDir(capturedTwo);
-                  QDir absDir;
-                  m_pFileSystemModel->setRootPath(absDir.absoluteFilePath(capturedTwo));
               }
               else if (captured == "g_outdir")
               {
                   m_sOutDir = capturedTwo;
                   ui->outDirectory->setText(m_sOutDir);
-                  QDir absDir;
-                  m_pFileSystemModel->setRootPath(absDir.absoluteFilePath(m_sOutDir));
               }
               else if (captured == "g_pattern")
               {
@@ -535,7 +678,7 @@ void MainWindow::readInLastDirs(const QString& fileLoc)
     }
 }
 
-void MainWindow::replaceUserOption(const QString& key, const QString& value, bool coreVal)
+QString MainWindow::withUserOption(const QString& optionsText, const QString& key, const QString& value, bool coreVal)
 {
     QString str, rpl;
     if (!coreVal)
@@ -548,6 +691,14 @@ void MainWindow::replaceUserOption(const QString& key, const QString& value, boo
         str = "^:-asserta\\(" % key % R"((.*)\)\)\.$)";
         rpl = ":-asserta(" % key % "('" % value % "')).";
     }
+    QRegularExpression re(str, QRegularExpression::InvertedGreedinessOption | QRegularExpression::MultilineOption);
+    QString dataText = optionsText;
+    dataText.replace(re, rpl);
+    return dataText;
+}
+
+void MainWindow::replaceUserOption(const QString& key, const QString& value, bool coreVal)
+{
     QFile file(m_sLastDirsPath);
     if(!file.open(QIODevice::Text | QIODevice::ReadWrite))
     {
@@ -557,8 +708,7 @@ void MainWindow::replaceUserOption(const QString& key, const QString& value, boo
     QString dataText = file.readAll();
     file.close();
 
-    QRegularExpression re(str, QRegularExpression::InvertedGreedinessOption | QRegularExpression::MultilineOption);
-    dataText.replace(re, rpl);
+    dataText = withUserOption(dataText, key, value, coreVal);
 
     if(file.open(QFile::WriteOnly | QFile::Truncate))
     {
@@ -647,6 +797,154 @@ void MainWindow::onAboutTriggered()
                           "for usage in Neverwinter Nights: Enhanced Edition."));
 }
 
+void MainWindow::onWorkerLimitsTriggered()
+{
+    const ProcessLimits limits = savedProcessLimits();
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("Worker Limits"));
+    auto *form = new QFormLayout(&dialog);
+    auto *addressSpaceSpin = new QSpinBox(&dialog);
+    addressSpaceSpin->setRange(0, 1048576);
+    addressSpaceSpin->setSingleStep(256);
+    addressSpaceSpin->setSuffix(" MB");
+    addressSpaceSpin->setSpecialValueText(tr("No limit"));
+    addressSpaceSpin->setValue(int(limits.addressSpaceMB));
+    addressSpaceSpin->setWhatsThis(tr("Address space of a single worker. A model that needs more fails with a resource limit status instead of exhausting the computer's memory."));
+    auto *cpuTimeSpin = new QSpinBox(&dialog);
+    cpuTimeSpin->setRange(0, 86400);
+    cpuTimeSpin->setSuffix(" s");
+    cpuTimeSpin->setSpecialValueText(tr("No limit"));
+    cpuTimeSpin->setValue(limits.cpuSeconds);
+    cpuTimeSpin->setWhatsThis(tr("CPU time a single worker run may use."));
+    auto *niceSpin = new QSpinBox(&dialog);
+    niceSpin->setRange(0, 19);
+    niceSpin->setValue(limits.niceLevel);
+    niceSpin->setWhatsThis(tr("Scheduling priority of the workers, higher values leave more of the CPU to other programs."));
+    auto *cpusEdit = new QLineEdit(&dialog);
+    cpusEdit->setPlaceholderText(tr("Any CPU, e.g. 0-3,6"));
+    QStringList cpuList;
+    for (int cpu : limits.cpus)
+        cpuList << QString::number(cpu);
+    cpusEdit->setText(cpuList.join(','));
+    cpusEdit->setWhatsThis(tr("Only run the workers on these CPUs."));
+    QSettings settings(QCoreApplication::organizationName(), QCoreApplication::applicationName());
+    auto *prefetchSpin = new QSpinBox(&dialog);
+    prefetchSpin->setRange(0, 65536);
+    prefetchSpin->setSingleStep(64);
+    prefetchSpin->setSuffix(" MB");
+    prefetchSpin->setSpecialValueText(tr("Off"));
+    prefetchSpin->setValue(settings.value("prefetchBudgetMB", 256).toInt());
+    prefetchSpin->setWhatsThis(tr("Memory for models read ahead of their run. The next chunks are copied into RAM while the workers clean, so a slow input folder does not hold them up between models."));
+    form->addRow(tr("Memory per worker:"), addressSpaceSpin);
+    form->addRow(tr("CPU time per run:"), cpuTimeSpin);
+    form->addRow(tr("Nice level:"), niceSpin);
+    form->addRow(tr("CPU set:"), cpusEdit);
+    form->addRow(tr("Read-ahead memory:"), prefetchSpin);
+    if (!LimitedProcess::isSupported())
+    {
+        form->addRow(new QLabel(tr("Worker limits are not supported on this system."), &dialog));
+        addressSpaceSpin->setEnabled(false);
+        cpuTimeSpin->setEnabled(false);
+        niceSpin->setEnabled(false);
+        cpusEdit->setEnabled(false);
+    }
+    auto *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+    if (dialog.exec() != QDialog::Accepted)
+        return;
+
+    settings.setValue("limitAddressSpaceMB", addressSpaceSpin->value());
+    settings.setValue("limitCpuSeconds", cpuTimeSpin->value());
+    settings.setValue("limitNice", niceSpin->value());
+    settings.setValue("limitCpus", cpusEdit->text().trimmed());
+    settings.setValue("prefetchBudgetMB", prefetchSpin->value());
+}
+
+ProcessLimits MainWindow::savedProcessLimits()
+{
+    ProcessLimits limits;
+    if (!LimitedProcess::isSupported())
+        return limits;
+    QSettings settings(QCoreApplication::organizationName(), QCoreApplication::applicationName());
+    limits.addressSpaceMB = settings.value("limitAddressSpaceMB", 0).toLongLong();
+    limits.cpuSeconds = settings.value("limitCpuSeconds", 0).toInt();
+    limits.niceLevel = settings.value("limitNice", 0).toInt();
+    limits.cpus = ProcessLimits::parseCpuList(settings.value("limitCpus").toString());
+    return limits;
+}
+
+void MainWindow::onRemoteAgentsTriggered()
+{
+    QSettings settings(QCoreApplication::organizationName(), QCoreApplication::applicationName());
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("Remote Agents"));
+    auto *form = new QFormLayout(&dialog);
+    auto *label = new QLabel(tr("One agent per line as host:port, optionally followed by the number of chunks it runs at once. "
+                                "Start the agents with cleanmodels-agent --listen <port> <address> on the hosts and the token "
+                                "below in CLEANMODELS_AGENT_TOKEN, they take the chunks the local workers leave over."), &dialog);
+    label->setWordWrap(true);
+    auto *agentsEdit = new QPlainTextEdit(&dialog);
+    agentsEdit->setPlaceholderText(tr("buildhost:%1 4").arg(RemoteProtocol::DefaultPort));
+    agentsEdit->setPlainText(settings.value("remoteAgents").toString());
+    auto *tokenEdit = new QLineEdit(settings.value("agentToken").toString(), &dialog);
+    tokenEdit->setEchoMode(QLineEdit::PasswordEchoOnEdit);
+    form->addRow(label);
+    form->addRow(agentsEdit);
+    form->addRow(tr("Token:"), tokenEdit);
+    if (!qEnvironmentVariableIsEmpty("CLEANMODELS_AGENTS"))
+        form->addRow(new QLabel(tr("CLEANMODELS_AGENTS is set and takes the place of this list."), &dialog));
+    if (!qEnvironmentVariableIsEmpty(RemoteProtocol::TokenVariable))
+        form->addRow(new QLabel(tr("%1 is set and takes the place of this token.").arg(RemoteProtocol::TokenVariable), &dialog));
+    auto *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+    if (dialog.exec() != QDialog::Accepted)
+        return;
+    settings.setValue("remoteAgents", agentsEdit->toPlainText().trimmed());
+    settings.setValue("agentToken", tokenEdit->text().trimmed());
+}
+
+QString MainWindow::savedAgentToken()
+{
+    QString token = QString::fromLocal8Bit(qgetenv(RemoteProtocol::TokenVariable));
+    if (token.isEmpty())
+    {
+        QSettings settings(QCoreApplication::organizationName(), QCoreApplication::applicationName());
+        token = settings.value("agentToken").toString();
+    }
+    return token;
+}
+
+// CLEANMODELS_AGENTS, a comma separated list, takes the place of the saved
+// one, e.g. for agents started on localhost
+QVector<RemoteAgent> MainWindow::savedRemoteAgents()
+{
+    QString list = QString::fromLocal8Bit(qgetenv("CLEANMODELS_AGENTS"));
+    if (list.isEmpty())
+    {
+        QSettings settings(QCoreApplication::organizationName(), QCoreApplication::applicationName());
+        list = settings.value("remoteAgents").toString();
+    }
+    QVector<RemoteAgent> agents;
+    for (const QString &entry : list.split(QRegularExpression("[,\\n]"), Qt::SkipEmptyParts))
+    {
+        const QStringList fields = entry.simplified().split(' ', Qt::SkipEmptyParts);
+        if (fields.isEmpty())
+            continue;
+        RemoteAgent agent;
+        agent.address = fields.first();
+        if (!agent.address.contains(':'))
+            agent.address += ":" % QString::number(RemoteProtocol::DefaultPort);
+        if (fields.count() > 1)
+            agent.slots = qMax(1, fields.at(1).toInt());
+        agents.append(agent);
+    }
+    return agents;
+}
+
 void MainWindow::onHelpTriggered()
 {
     QWhatsThis::enterWhatsThisMode();
@@ -654,8 +952,8 @@ void MainWindow::onHelpTriggered()
 
 void MainWindow::onQuitTriggered()
 {
-    if (m_bCleanRunning)
-        m_pCleanProcess->kill();
+    if (m_bRunActive)
+        abortRun();
 
     QApplication::quit();
 }
@@ -698,8 +996,10 @@ void MainWindow::on_decompileCheck_stateChanged(int arg1)
     }
 }
 
-void MainWindow::onDirectoryContentsChanged()
+void MainWindow::onDirectoryContentsChanged(const QString& path)
 {
+    if (m_bWatching)
+        m_watchChanged.insert(path);
     m_dirWatcherTimer->stop();
     m_bFilesHaveChanged = true;
     m_dirWatcherTimer->start();
@@ -710,7 +1010,13 @@ void MainWindow::handleDirWatcherTimer()
     if (m_bFilesHaveChanged)
     {
         m_bFilesHaveChanged = false;
-        if (m_bCleanRunning)
+        // Watch mode lists only the folders that changed, the table and the
+        // scans of the whole input are left as they are
+        if (m_bWatching)
+        {
+            scanWatchedFolders();
+        }
+        else if (m_bCleanRunning)
         {
             m_bUpdateFilesAfterClean = true;
         }
@@ -721,44 +1027,307 @@ void MainWindow::handleDirWatcherTimer()
 
 void MainWindow::updateFileListing()
 {
-    ui->filesTable->setRowCount(0);
-    auto pattern = ui->filePattern->text();
-    QDir dir(ui->inDirectory->text());
-    dir.setNameFilters((QStringList(pattern)));
-    dir.setFilter(QDir::Files | QDir::NoDotAndDotDot | QDir::Readable | QDir::CaseSensitive);
-    QStringList totalfiles = dir.entryList();
-    ui->mdlsDetectedLabel->setText(tr("Files detected: ") % QString::number(totalfiles.count()));
+    stopDuplicateScan();
+    stopStatsScan();
+    if (m_pDirWalker)
+    {
+        m_pDirWalker->cancel();
+        m_pDirWalker = nullptr;
+    }
+    if (ErfArchive::isArchivePath(ui->inDirectory->text()))
+    {
+        listArchive(ui->inDirectory->text());
+        return;
+    }
+    if (m_pInArchive && !m_bCleanRunning)
+        m_pInArchive->close();
+    m_pDirWalker = new DirWalker(this);
+    connect(m_pDirWalker, &DirWalker::finished, this, &MainWindow::onFileListingReady);
+    m_pDirWalker->start(ui->inDirectory->text(), QStringList(ui->filePattern->text()), ui->recursiveCheck->isChecked());
+}
+
+void MainWindow::onFileListingReady()
+{
+    auto *walker = qobject_cast<DirWalker*>(sender());
+    walker->deleteLater();
+    if (walker != m_pDirWalker)
+        return; // superseded by a newer listing
+    m_pDirWalker = nullptr;
+    if (m_bCleanRunning)
+    {
+        m_bUpdateFilesAfterClean = true;
+        return;
+    }
+    showModelEntries(walker->results());
+}
+
+void MainWindow::listArchive(const QString& archivePath)
+{
+    // Pending runs write their inputs straight from the mapping
+    if (m_bCleanRunning)
+    {
+        m_bUpdateFilesAfterClean = true;
+        return;
+    }
+    if (!m_pInArchive)
+        m_pInArchive = new ErfArchive();
+    QVector<ModelEntry> entries;
+    if (!m_pInArchive->open(archivePath))
+    {
+        QString errorMsg = "<p><span style=\"color:red;\">" % tr("Could not read archive ") % archivePath % ": " % m_pInArchive->errorString() % "</span></p><br>";
+        appendLog(ui->debugTextBrowser, errorMsg);
+    }
+    else
+    {
+        entries = archiveModels(m_pInArchive, ui->filePattern->text());
+    }
+    showModelEntries(entries);
+}
+
+QVector<ModelEntry> MainWindow::archiveModels(const ErfArchive *archive, const QString& pattern)
+{
+    QVector<ModelEntry> entries;
+    const QVector<ErfEntry> &resources = archive->entries();
+    for (int i = 0; i < resources.size(); ++i)
+    {
+        if (resources.at(i).resType != ErfArchive::ResTypeMdl)
+            continue;
+        const QString fileName = archive->resourceFileName(i);
+        if (!QDir::match(pattern, fileName))
+            continue;
+        ModelEntry entry;
+        entry.relPath = fileName;
+        entry.size = resources.at(i).size;
+        entry.isASCII = DirWalker::isASCIIHeader(archive->resourceData(i).left(256));
+        entry.archiveIndex = i;
+        entries.append(entry);
+    }
+    return entries;
+}
+
+void MainWindow::showModelEntries(const QVector<ModelEntry>& entries)
+{
+    m_modelEntries = entries;
+
+    ui->mdlsDetectedLabel->setText(tr("Files detected: ") % QString::number(m_modelEntries.count()));
     if (!ui->decompileCheck->isChecked())
         ui->mdlsCleanedLabel->setText(tr("Files Cleaned: 0"));
     else
         ui->mdlsCleanedLabel->setText(tr("Files Decompiled: 0"));
     ui->mdlsFailedLabel->setText(tr("Failures: 0"));
 
-    for (const QString &filePath : totalfiles)
+    fillResultsTable(ui->filesTable, m_modelEntries, m_modelItems);
+    startDuplicateScan();
+    startStatsScan();
+    if (m_bWatching)
+        noteWatchedEntries(entries);
+    if (m_bAwaitingFirstListing)
+    {
+        m_bAwaitingFirstListing = false;
+        startupStepDone();
+    }
+}
+
+ResultsBrowser *MainWindow::setupResultsTable(QTableWidget *table)
+{
+    table->setColumnCount(13);
+    table->setColumnWidth(1, 100);
+    table->setColumnWidth(2, 140);
+    table->setColumnWidth(3, 70);
+    table->setColumnWidth(4, 100);
+    table->setColumnWidth(5, 60);
+    for (int column = 6; column < 13; ++column)
+        table->setColumnWidth(column, 64);
+    table->setHorizontalHeaderLabels({"File", "Size", "Status", "Fixes", "Time", "Group",
+                                      "Nodes", "Trimesh", "AABB", "Skin", "Verts", "Faces", "Anims"});
+    table->setAlternatingRowColors(true);
+    table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    table->horizontalHeader()->setVisible(true);
+    table->verticalHeader()->setDefaultSectionSize(20);
+    table->verticalHeader()->setVisible(false);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setSelectionMode(QAbstractItemView::SingleSelection);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    // Sorting goes through the browser's view, rows stay where they were added
+    return new ResultsBrowser(table);
+}
+
+void MainWindow::fillResultsTable(QTableWidget *table, const QVector<ModelEntry>& entries, QHash<QString, QTableWidgetItem*>& items)
+{
+    table->setRowCount(0);
+    items.clear();
+    items.reserve(entries.count());
+    appendResultRows(table, entries, items);
+}
+
+// Models already in the table get their row back with a fresh size
+void MainWindow::appendResultRows(QTableWidget *table, const QVector<ModelEntry>& entries, QHash<QString, QTableWidgetItem*>& items)
+{
+    int row = table->rowCount();
+    table->setRowCount(row + entries.count());
+    for (const ModelEntry &entry : entries)
     {
-        QFile inputFile(ui->inDirectory->text() % "/" % filePath);
-        QTextStream stream(&inputFile);
-        inputFile.open(QIODevice::ReadOnly);
-        if (!inputFile.isOpen())
+        if (QTableWidgetItem *known = items.value(entry.relPath))
+        {
+            table->item(known->row(), 1)->setText(QString::number(entry.size));
+            delete table->takeItem(known->row(), 2);
             continue;
-        auto line = stream.readLine().trimmed().toStdString();
-        inputFile.close();
-        auto isASCII = std::all_of(line.begin(), line.end(), ::isprint);
-        auto *fileNameItem = new QTableWidgetItem(filePath);
-        fileNameItem->setIcon(isASCII ? m_iconASCIIMdl : m_iconBinaryMdl);
-        fileNameItem->setToolTip(isASCII ? tr("ASCII MDL") : tr("Binary MDL"));
+        }
+        auto *fileNameItem = new QTableWidgetItem(entry.relPath);
+        fileNameItem->setIcon(entry.isASCII ? m_iconASCIIMdl : m_iconBinaryMdl);
+        fileNameItem->setToolTip(entry.isASCII ? tr("ASCII MDL") : tr("Binary MDL"));
+        fileNameItem->setData(ResultsProxyModel::BinaryRole, !entry.isASCII);
         auto *fileSizeItem = new QTableWidgetItem();
-        fileSizeItem->setText(QString::number(inputFile.size()));
+        fileSizeItem->setText(QString::number(entry.size));
         auto *fixesItem = new QTableWidgetItem("0");
         fixesItem->setTextAlignment(Qt::AlignCenter);
         auto *timerItem = new QTableWidgetItem("00:00.000");
         timerItem->setTextAlignment(Qt::AlignCenter);
-        int row = ui->filesTable->rowCount();
-        ui->filesTable->insertRow(row);
-        ui->filesTable->setItem(row, 0, fileNameItem);
-        ui->filesTable->setItem(row, 1, fileSizeItem);
-        ui->filesTable->setItem(row, 3, fixesItem);
-        ui->filesTable->setItem(row, 4, timerItem);
+        table->setItem(row, 0, fileNameItem);
+        table->setItem(row, 1, fileSizeItem);
+        table->setItem(row, 3, fixesItem);
+        table->setItem(row, 4, timerItem);
+        items.insert(entry.relPath, fileNameItem);
+        ++row;
+    }
+    table->setRowCount(row);
+}
+
+void MainWindow::startDuplicateScan()
+{
+    stopDuplicateScan();
+    m_duplicates.clear();
+    m_duplicateOf.clear();
+    if (!ui->dedupeCheck->isChecked() || m_modelEntries.count() < 2)
+        return;
+    m_pDuplicateScanner = new DuplicateScanner(this);
+    connect(m_pDuplicateScanner, &DuplicateScanner::finished, this, &MainWindow::onDuplicateScanReady, Qt::QueuedConnection);
+    m_pDuplicateScanner->start(m_modelEntries, ui->inDirectory->text(), inputIsArchive() ? m_pInArchive : nullptr);
+}
+
+void MainWindow::stopDuplicateScan()
+{
+    if (!m_pDuplicateScanner)
+        return;
+    m_pDuplicateScanner->cancel();
+    m_pDuplicateScanner->deleteLater();
+    m_pDuplicateScanner = nullptr;
+}
+
+void MainWindow::startStatsScan()
+{
+    stopStatsScan();
+    m_modelStats.clear();
+    if (m_modelEntries.isEmpty())
+        return;
+    m_pStatsScanner = new MdlStatsScanner(this);
+    connect(m_pStatsScanner, &MdlStatsScanner::finished, this, &MainWindow::onStatsScanReady, Qt::QueuedConnection);
+    m_pStatsScanner->start(m_modelEntries, ui->inDirectory->text(), inputIsArchive() ? m_pInArchive : nullptr);
+}
+
+void MainWindow::stopStatsScan()
+{
+    if (!m_pStatsScanner)
+        return;
+    m_pStatsScanner->cancel();
+    m_pStatsScanner->deleteLater();
+    m_pStatsScanner = nullptr;
+}
+
+void MainWindow::onStatsScanReady()
+{
+    auto *scanner = qobject_cast<MdlStatsScanner*>(sender());
+    if (scanner != m_pStatsScanner)
+        return;
+    m_pStatsScanner = nullptr;
+    scanner->deleteLater();
+    const QVector<ModelEntry> entries = scanner->entries();
+    const QVector<MdlStats> stats = scanner->stats();
+    for (int i = 0; i < entries.count(); ++i)
+    {
+        if (stats.at(i).valid)
+            m_modelStats.insert(entries.at(i).relPath, stats.at(i));
+    }
+    showModelStats(ui->filesTable, m_modelItems, m_modelStats);
+    appendLog(ui->debugTextBrowser, tr("Profiled %1 ASCII models, %2 MB in %3 ms<br>")
+              .arg(m_modelStats.count()).arg(double(scanner->bytesScanned()) / (1024 * 1024), 0, 'f', 1).arg(scanner->elapsedMs()));
+}
+
+void MainWindow::showModelStats(QTableWidget *table, const QHash<QString, QTableWidgetItem*>& items, const QHash<QString, MdlStats>& stats)
+{
+    // Numbers as numbers, so the columns sort by value
+    for (auto it = stats.constBegin(); it != stats.constEnd(); ++it)
+    {
+        const QTableWidgetItem *fileNameItem = items.value(it.key());
+        if (!fileNameItem)
+            continue;
+        const MdlStats &modelStats = it.value();
+        const qint64 values[] = {modelStats.nodes, modelStats.trimeshes, modelStats.aabbs, modelStats.skins,
+                                 modelStats.verts, modelStats.faces, modelStats.animations};
+        for (int i = 0; i < 7; ++i)
+        {
+            auto *valueItem = new QTableWidgetItem();
+            valueItem->setData(Qt::DisplayRole, QVariant(qlonglong(values[i])));
+            valueItem->setTextAlignment(Qt::AlignCenter);
+            table->setItem(fileNameItem->row(), 6 + i, valueItem);
+        }
+    }
+}
+
+void MainWindow::onDuplicateScanReady()
+{
+    auto *scanner = qobject_cast<DuplicateScanner*>(sender());
+    if (scanner != m_pDuplicateScanner)
+        return;
+    m_pDuplicateScanner = nullptr;
+    scanner->deleteLater();
+    if (scanner->groups().count() != m_modelEntries.count() || !scanner->groupCount())
+        return;
+    showDuplicateGroups(scanner, m_modelEntries, ui->filesTable, m_modelItems, m_duplicates, m_duplicateOf, !m_bCleanRunning);
+    appendLog(ui->debugTextBrowser, QString::number(m_duplicateOf.count()) % tr(" duplicate models found in ") % QString::number(scanner->groupCount()) % tr(" groups, each group is cleaned once.<br>"));
+}
+
+void MainWindow::showDuplicateGroups(const DuplicateScanner *scanner, const QVector<ModelEntry>& entries, QTableWidget *table,
+                                     const QHash<QString, QTableWidgetItem*>& items, QHash<QString, QStringList>& duplicates,
+                                     QHash<QString, QString>& duplicateOf, bool markCopies)
+{
+    const QVector<int> groups = scanner->groups();
+    QVector<QString> representatives(scanner->groupCount());
+    for (int i = 0; i < groups.count(); ++i)
+    {
+        const int group = groups.at(i);
+        if (group < 0)
+            continue;
+        const QString &relPath = entries.at(i).relPath;
+        if (representatives.at(group).isEmpty())
+        {
+            representatives[group] = relPath;
+            continue;
+        }
+        duplicateOf.insert(relPath, representatives.at(group));
+        duplicates[representatives.at(group)].append(relPath);
+    }
+
+    for (int i = 0; i < groups.count(); ++i)
+    {
+        const int group = groups.at(i);
+        if (group < 0)
+            continue;
+        const QString &relPath = entries.at(i).relPath;
+        const QString &representative = representatives.at(group);
+        auto *item = items.value(relPath);
+        const int row = item ? item->row() : 0;
+        auto *groupItem = new QTableWidgetItem();
+        groupItem->setData(Qt::DisplayRole, group + 1);
+        groupItem->setTextAlignment(Qt::AlignCenter);
+        groupItem->setToolTip(tr("Identical to ") % (relPath == representative ? duplicates.value(representative).join(", ") : representative));
+        table->setItem(row, 5, groupItem);
+        if (relPath != representative && markCopies)
+        {
+            auto *twiDuplicate = new QTableWidgetItem(tr("Duplicate"));
+            twiDuplicate->setToolTip(tr("Copied from ") % representative);
+            table->setItem(row, 2, twiDuplicate);
+        }
     }
 }
 
@@ -771,7 +1340,11 @@ void MainWindow::onUpdateInDir(const QString& newInDir)
     m_fsWatcher.addPath(newInDir);
     ui->inDirectory->setText(newInDir);
     replaceUserOption("g_indir", newInDir, true);
+    const bool watching = m_bWatching;
+    stopWatching();
     m_sInDir = newInDir;
+    if (watching)
+        startWatching();
     updateFileListing();
     m_dirWatcherTimer->start();
 }
@@ -798,7 +1371,12 @@ void MainWindow::on_inDirectory_textChanged(const QString &arg1)
     QString s, f;
     s = dir.relativeFilePath(arg1);
     f = dir.absoluteFilePath(arg1);
-    if ((!inputDir.exists()) || (!inputDir.isDir()) || (!inputDir.isWritable()))
+    if (ErfArchive::isArchivePath(arg1) && inputDir.isFile())
+    {
+        ui->inDirectory->setStatusTip(tr("Input archive resolved as ") %f);
+        ui->inDirectory->setStyleSheet("");
+    }
+    else if ((!inputDir.exists()) || (!inputDir.isDir()) || (!inputDir.isWritable()))
     {
         if (QFile(s).exists())
         {
@@ -818,7 +1396,8 @@ void MainWindow::on_inDirectory_textChanged(const QString &arg1)
 void MainWindow::on_inDirectory_editingFinished()
 {
     const QFileInfo outputDir(ui->inDirectory->text());
-    if ((!outputDir.exists()) || (!outputDir.isDir()) || (!outputDir.isWritable()))
+    bool isArchive = ErfArchive::isArchivePath(ui->inDirectory->text()) && outputDir.isFile();
+    if (!isArchive && ((!outputDir.exists()) || (!outputDir.isDir()) || (!outputDir.isWritable())))
     {
         ui->inDirectory->setStyleSheet("color: #FF0000");
         ui->cleanButton->setEnabled(false);
@@ -833,6 +1412,37 @@ void MainWindow::on_inDirectory_editingFinished()
     }
 }
 
+void MainWindow::onOpenArchiveTriggered()
+{
+    QFileDialog fileDialog(this);
+    fileDialog.setAcceptMode(QFileDialog::AcceptMode::AcceptOpen);
+    fileDialog.setFileMode(QFileDialog::ExistingFile);
+    fileDialog.setNameFilters({tr("NWN Archives (*.hak *.erf *.mod)")});
+    fileDialog.setDirectory(QFileInfo(m_sInDir).absolutePath());
+    if (fileDialog.exec())
+    {
+        ui->inDirectory->setStyleSheet("");
+        ui->cleanButton->setEnabled(true);
+        onUpdateInDir(fileDialog.selectedFiles().at(0));
+    }
+}
+
+void MainWindow::onOutputArchiveTriggered()
+{
+    QFileDialog fileDialog(this);
+    fileDialog.setAcceptMode(QFileDialog::AcceptMode::AcceptSave);
+    fileDialog.setFileMode(QFileDialog::AnyFile);
+    fileDialog.setDefaultSuffix("hak");
+    fileDialog.setNameFilters({tr("NWN Archives (*.hak *.erf *.mod)")});
+    fileDialog.setDirectory(QFileInfo(m_sOutDir).absolutePath());
+    if (fileDialog.exec())
+    {
+        ui->outDirectory->setText(fileDialog.selectedFiles().at(0));
+        m_sOutDir = ui->outDirectory->text();
+        replaceUserOption("g_outdir", m_sOutDir, true);
+    }
+}
+
 void MainWindow::on_outdirButton_released()
 {
     QFileDialog dialog(this);
@@ -1392,25 +2002,30 @@ void MainWindow::on_retileWaterCombo_currentIndexChanged(int index)
     }
 }
 
-void MainWindow::on_filesTable_customContextMenuRequested(const QPoint &pos)
+void MainWindow::onFilesContextMenu(int row, const QPoint& globalPos)
 {
-    // Handle global position
-    QPoint globalPos = ui->filesTable->mapToGlobal(pos);
+    // The actions work on the selected row
+    ui->filesTable->selectRow(row);
 
     // Create menu and insert some actions
     QMenu myMenu;
     myMenu.addAction(tr("Copy path to clipboard"), this, SLOT(copyToClipboard()));
+    myMenu.addAction(tr("Compare input with output"), this, SLOT(compareModel()));
     myMenu.exec(globalPos);
 }
 
-void MainWindow::on_filesTable_doubleClicked(const QModelIndex &index)
+void MainWindow::onFilesRowDoubleClicked(int row)
 {
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 11, 0))
-    QString cellText = index.siblingAtColumn(0).data().toString();
-    ui->debugTextBrowser->moveCursor(QTextCursor::Start);
-    if (!ui->debugTextBrowser->find(cellText))
-        ui->debugTextBrowser->moveCursor(QTextCursor::End);
-#endif
+    // The latest run of the main window knows where its models are in the log
+    const QString model = ui->filesTable->item(row, 0) ? ui->filesTable->item(row, 0)->text() : QString();
+    for (int i = m_jobs.count() - 1; i >= 0; --i)
+    {
+        if (m_jobs.at(i)->table == ui->filesTable)
+        {
+            showModelLog(m_jobs.at(i), model);
+            return;
+        }
+    }
 }
 
 void MainWindow::setRescaleOption()
@@ -1461,3 +2076,56 @@ void MainWindow::on_rescaleZSpin_valueChanged(double)
 {
     setRescaleOption();
 }
+
+void MainWindow::on_decompileWorkersSpin_valueChanged(int value)
+{
+    QSettings settings(QCoreApplication::organizationName(), QCoreApplication::applicationName());
+    settings.setValue("decompileWorkers", value);
+}
+
+void MainWindow::on_cleanWorkersSpin_valueChanged(int value)
+{
+    QSettings settings(QCoreApplication::organizationName(), QCoreApplication::applicationName());
+    settings.setValue("cleanWorkers", value);
+}
+
+void MainWindow::on_adaptiveWorkersCheck_toggled(bool checked)
+{
+    QSettings settings(QCoreApplication::organizationName(), QCoreApplication::applicationName());
+    settings.setValue("adaptiveWorkers", checked);
+}
+
+void MainWindow::onPersistentWorkersToggled(bool checked)
+{
+    QSettings settings(QCoreApplication::organizationName(), QCoreApplication::applicationName());
+    settings.setValue("persistentWorkers", checked);
+}
+
+void MainWindow::on_memoryCeilingSpin_valueChanged(int value)
+{
+    QSettings settings(QCoreApplication::organizationName(), QCoreApplication::applicationName());
+    settings.setValue("memoryCeilingMB", value);
+}
+
+void MainWindow::on_dedupeCheck_toggled(bool checked)
+{
+    QSettings settings(QCoreApplication::organizationName(), QCoreApplication::applicationName());
+    settings.setValue("dedupe", checked);
+    showModelEntries(m_modelEntries);
+}
+
+void MainWindow::on_recursiveCheck_toggled(bool checked)
+{
+    QSettings settings(QCoreApplication::organizationName(), QCoreApplication::applicationName());
+    settings.setValue("recursive", checked);
+    m_dirWatcherTimer->stop();
+    m_bFilesHaveChanged = false;
+    // The subfolders are watched or let go, from a new baseline
+    if (m_bWatching)
+    {
+        stopWatching();
+        startWatching();
+    }
+    updateFileListing();
+    m_dirWatcherTimer->start();
+}
@@ -1,17 +1,44 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
+#include "cleanjob.h"
+#include "cleantask.h"
+#include "cleanworker.h"
+#include "dirwalker.h"
+#include "duplicatescanner.h"
+#include "erfarchive.h"
+#include "erfwriter.h"
+#include "limitedprocess.h"
+#include "loadmonitor.h"
+#include "mdlstatsscanner.h"
+#include "logindex.h"
+#include "metrics.h"
+#include "outputcommitter.h"
+#include "prefetcher.h"
 #include <QCompleter>
+#include <QDateTime>
 #include <QElapsedTimer>
 #include <QFileSystemWatcher>
+#include <QHash>
 #include <QIcon>
 #include <QLabel>
 #include <QProcess>
 #include <QProgressBar>
 #include <QTableWidgetItem>
+#include <QTemporaryDir>
+#include <QThreadPool>
 #include <QTimer>
 #include <QMainWindow>
 
-class FileSystemModel;
+class QTableWidget;
+class ResultsBrowser;
+class QTextBrowser;
+
+// A model that landed in the watched folder and may still be being written
+struct WatchedModel
+{
+    ModelEntry entry;
+    int stableTicks = 0;
+};
 
 namespace Ui {
 class MainWindow;
@@ -25,8 +52,14 @@ public:
     explicit MainWindow(QWidget *parent = nullptr);
     ~MainWindow() override;
 
+signals:
+    // For the startup benchmark
+    void firstFramePainted();
+    void startupFinished();
+
 protected:
     void closeEvent(QCloseEvent *event) override;
+    void paintEvent(QPaintEvent *event) override;
 
 private slots:
     void on_indirButton_released();
@@ -38,9 +71,22 @@ private slots:
     void onLoadConfigTriggered();
     void onQuitTriggered();
     void onAboutTriggered();
+    void onWorkerLimitsTriggered();
+    void onRemoteAgentsTriggered();
+    void onPauseToggled(bool paused);
+    void onPersistentWorkersToggled(bool checked);
+    void onWatchModeToggled(bool checked);
+    void onWatchTimer();
+    void onFixBreakdownTriggered();
+    void onRenderCostTriggered();
     void handleDirWatcherTimer();
-    void onDirectoryContentsChanged();
+    void onDirectoryContentsChanged(const QString& path);
     void updateFileListing();
+    void onFileListingReady();
+    void onDuplicateScanReady();
+    void onStatsScanReady();
+    void onOpenArchiveTriggered();
+    void onOutputArchiveTriggered();
     void on_cullInvisibleCheck_toggled(bool checked);
     void on_meshMergeCheck_toggled(bool checked);
     void on_forceWhiteCheck_toggled(bool checked);
@@ -84,27 +130,43 @@ private slots:
     void on_retileWaterCombo_currentIndexChanged(int index);
     void on_outDirectory_textChanged(const QString &arg1);
     void on_filePattern_textChanged(const QString &arg1);
-    void on_filesTable_customContextMenuRequested(const QPoint &pos);
-    void on_filesTable_doubleClicked(const QModelIndex &index);
+    void onFilesContextMenu(int row, const QPoint& globalPos);
+    void onFilesRowDoubleClicked(int row);
     void on_rescaleLockBtn_clicked(bool checked);
     void on_rescaleXSpin_valueChanged(double arg1);
     void on_rescaleYSpin_valueChanged(double arg1);
     void on_rescaleZSpin_valueChanged(double arg1);
+    void on_recursiveCheck_toggled(bool checked);
+    void on_dedupeCheck_toggled(bool checked);
+    void on_decompileWorkersSpin_valueChanged(int value);
+    void on_cleanWorkersSpin_valueChanged(int value);
+    void on_adaptiveWorkersCheck_toggled(bool checked);
+    void on_memoryCeilingSpin_valueChanged(int value);
+    void onLoadSampleTimer();
+    void publishMetrics();
+    void on_queueCurrentButton_released();
+    void on_queuePresetButton_released();
+    void on_removeJobButton_released();
+    void on_jobsTable_currentCellChanged(int currentRow, int currentColumn, int previousRow, int previousColumn);
+    void on_logSearchEdit_textChanged(const QString& text);
+    void on_logSeverityCombo_currentIndexChanged(int index);
+    void on_logSearchTable_cellDoubleClicked(int row, int column);
 
     void onCaptureCleanModelsOutput();
-    void onCleanFinished(int, QProcess::ExitStatus);
+    void onCaptureCleanModelsErrors();
+    void onCleanFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void onModelCommitted(int jobId, const QString& modelKey, const QStringList& copies, const QString& error);
     void copyToClipboard();
+    void onCliProbed(const QString& path, const QDateTime& built);
+    void compareModel();
 
 private:
     Ui::MainWindow *ui;
-    FileSystemModel *m_pFileSystemModel = nullptr;
     QCompleter *m_pDirCompleter = nullptr;
     QLabel* m_pCleanStatus;
-    QProcess* m_pCleanProcess;
     QProgressBar* m_pStatusProgress;
     QString m_sBinaryName;
     QString m_sBinaryPath;
-    QString m_sCurrentModel;
     QString m_sInDir;
     QString m_sOutDir;
     QString m_sLastDirsPath;
@@ -120,24 +182,156 @@ private:
     QIcon m_iconBinaryMdl;
     QIcon m_iconLockRescaleBtn;
     QIcon m_iconUnlockRescaleBtn;
-    QElapsedTimer m_cleanTimer;
     QFileSystemWatcher m_fsWatcher;
+    DirWalker* m_pDirWalker = nullptr;
+    ErfArchive* m_pInArchive = nullptr;
+    QVector<ModelEntry> m_modelEntries;
+    QHash<QString, QTableWidgetItem*> m_modelItems;
+    DuplicateScanner* m_pDuplicateScanner = nullptr;
+    MdlStatsScanner* m_pStatsScanner = nullptr;
+    QHash<QString, MdlStats> m_modelStats;
+    QHash<QString, QStringList> m_duplicates; // representative -> identical models
+    QHash<QString, QString> m_duplicateOf; // identical model -> representative
+    QList<CleanJob*> m_jobs; // in the order of the job queue panel
+    CleanJob* m_pViewJob = nullptr; // the running job reporting into filesTable
+    int m_nJobSerial = 0;
+    QList<CleanWorker*> m_workers;
+    int m_nDecompileWorkers = 1;
+    int m_nCleanWorkers = 1;
+    int m_nWorkerBudget = 1; // workers of both stages together, adjusted to the system load
+    qint64 m_nPeakWorkerRssKb = 0;
+    LoadMonitor m_loadMonitor;
+    LogIndex m_logIndex;
+    ProcessLimits m_processLimits;
+    QVector<RemoteAgent> m_agents; // of this run
+    QString m_sAgentPath;
+    QString m_sAgentToken;
+    QTimer *m_pLoadTimer;
+    OutputCommitter* m_pCommitter = nullptr;
+    Prefetcher *m_pPrefetcher = nullptr;
     QTimer *m_dirWatcherTimer;
     bool m_bFilesHaveChanged;
     bool m_bUpdateFilesAfterClean;
     bool m_bCleanRunning;
-    int m_nMdlsCleaned = 0;
-    int m_nMdlsFailed = 0;
+    bool m_bRunActive = false; // any job listing or running
+    bool m_bPaused = false;
+    bool m_bPersistentWorkers = false; // this run hands models to --serve workers
+    bool m_bProbingCli = true;
+    bool m_bFirstFramePainted = false;
+    bool m_bAwaitingFirstListing = false;
+    int m_nStartupSteps = 2; // the CLI probe and the first listing
+    QThreadPool m_probePool;
+    RunMetrics m_metrics;
+    MetricsExporter *m_pMetricsExporter = nullptr;
+    QTimer *m_pMetricsTimer = nullptr;
+    QElapsedTimer m_metricsClock;
+    qint64 m_nMetricsLines = 0; // parser lines at the last update
+    bool m_bMetricsErrorShown = false;
+    bool m_bWatching = false;
+    bool m_bWatchBaseline = false; // the listing of what was there when watching started is in
+    int m_nWatchJobId = 0;
+    int m_nWatchBatch = 0;
+    QTimer *m_pWatchTimer = nullptr;
+    QHash<QString, QPair<qint64, qint64>> m_watchSeen; // size and time of the models cleaned or already there
+    QHash<QString, WatchedModel> m_watchPending; // landed, waiting to stop changing
+    QSet<QString> m_watchFolders; // below the input folder, watched while watch mode lists recursively
+    QSet<QString> m_watchChanged; // folders to list again on the next tick
 
     void onUpdateInDir(const QString& newInDir);
     void setRescaleOption();
     void replaceUserOption(const QString& str, const QString& rpl, bool coreValue = false);
+    static QString withUserOption(const QString& optionsText, const QString& key, const QString& value, bool coreValue = false);
     void readInLastDirs(const QString& fileLoc);
+    void listArchive(const QString& archivePath);
+    static QVector<ModelEntry> archiveModels(const ErfArchive *archive, const QString& pattern);
+    void showModelEntries(const QVector<ModelEntry>& entries);
+    ResultsBrowser *setupResultsTable(QTableWidget *table);
+    void fillResultsTable(QTableWidget *table, const QVector<ModelEntry>& entries, QHash<QString, QTableWidgetItem*>& items);
+    void appendResultRows(QTableWidget *table, const QVector<ModelEntry>& entries, QHash<QString, QTableWidgetItem*>& items);
+    void showDuplicateGroups(const DuplicateScanner *scanner, const QVector<ModelEntry>& entries, QTableWidget *table,
+                             const QHash<QString, QTableWidgetItem*>& items, QHash<QString, QStringList>& duplicates,
+                             QHash<QString, QString>& duplicateOf, bool markCopies);
+    void startDuplicateScan();
+    void stopDuplicateScan();
+    void startStatsScan();
+    void stopStatsScan();
+    void showModelStats(QTableWidget *table, const QHash<QString, QTableWidgetItem*>& items, const QHash<QString, MdlStats>& stats);
     void readSettings();
     void writeSettings();
+    void finishStartup();
+    void startWatching();
+    void stopWatching();
+    CleanJob *watchJob();
+    void warmWatchWorker(CleanJob *job);
+    void watchFolders(const QString& dirPath);
+    void scanWatchedFolders();
+    void noteWatchedEntries(const QVector<ModelEntry>& entries);
+    void enqueueWatched(QVector<ModelEntry> entries);
+    void setupMetrics();
+    void addBusyTime(const CleanWorker *worker);
+    void startupStepDone();
 
     void doClean();
-    int findModelRow(const QString& mdlFile);
+    CleanJob *newJob();
+    bool editJob(CleanJob *job);
+    void addJob(CleanJob *job);
+    void updateJobRow(CleanJob *job);
+    void updateJobCounters(CleanJob *job);
+    static void appendLog(QTextBrowser *log, const QString& html);
+    void appendJobLog(const CleanJob *job, const QString& html);
+    void appendModelLog(CleanJob *job, const QString& model, const QString& html, LogIndex::Severity severity, const QString& text);
+    void showModelLog(const CleanJob *job, const QString& model);
+    void revealModel(CleanJob *job, const QString& model);
+    bool settleFixes(CleanJob *job, CleanWorker *worker, int reported);
+    void runLogSearch();
+    void showRenderCostReport(const QString& jobName, const QVector<ModelEntry>& entries,
+                              const QVector<MdlStats>& before, const QVector<MdlStats>& after);
+    CleanJob *findJob(int id) const;
+    static QString coreOption(const QString& optionsText, const QString& key);
+    void activateJobs();
+    void listJob(CleanJob *job);
+    void onJobListingReady(int jobId);
+    void onJobDuplicatesReady(int jobId);
+    bool startJob(CleanJob *job);
+    void abortJob(CleanJob *job);
+    void finishJob(CleanJob *job);
+    void settleJobs();
+    void beginRun();
+    QList<CleanTask> buildCleanTasks(const CleanJob *job, const QVector<ModelEntry>& jobEntries, int batch = 0) const;
+    QString writeTaskOptions(CleanJob *job, const CleanTask& task);
+    bool inputIsArchive() const;
+    bool writeArchiveEntries(const CleanJob *job, const CleanTask& task);
+    QString selectionFolder(const CleanJob *job, const QString& name) const;
+    bool stageSelection(CleanJob *job, const CleanTask& task);
+    bool openOutputArchive(CleanJob *job);
+    void commitWrittenModel(CleanJob *job, const CleanWorker *worker, const QString& reportedPath);
+    void finishOutputArchive(CleanJob *job);
+    bool startTask(CleanTask task, int agent = -1);
+    QStringList taskModels(const CleanJob *job, const CleanTask& task) const;
+    void feedNextModel(CleanWorker *worker);
+    void completeTask(CleanJob *job, const CleanTask& task);
+    int runningWorkers(CleanTask::Stage stage) const;
+    int busyWorkers() const;
+    int jobWorkers(int jobId) const;
+    int agentWorkers(const QString& address) const;
+    int pickAgent() const;
+    void markAgentLost(const QString& address);
+    CleanJob *nextJob(CleanTask::Stage stage, bool handoffFull) const;
+    bool scheduleTasks();
+    void prefetchUpcoming();
+    qint64 modelElapsed(const CleanWorker *worker) const;
+    CleanTask remainingTask(CleanJob *job, const CleanWorker *worker, bool withCurrent = false);
+    static ProcessLimits savedProcessLimits();
+    static QVector<RemoteAgent> savedRemoteAgents();
+    static QString savedAgentToken();
+    void abortRun();
+    void reportStartFailure();
+    void finishRun();
+    CleanWorker *workerFor(QObject *process) const;
+    void drainWorker(CleanWorker *worker, QProcess::ProcessChannel channel);
+    void parseWorkerLine(CleanWorker *worker, const QString& line, bool fromStderr = false);
+    QString modelKey(const CleanWorker *worker, const QString& reportedPath) const;
+    static int findModelRow(const CleanJob *job, const QString& mdlFile);
 };
 
 #endif // MAINWINDOW_H
@@ -1,226 +1,1319 @@
 ﻿#include "mainwindow.h"
 #include "ui_mainwindow.h"
-#include <QDirIterator>
+#include "fixcatalog.h"
+#include "remoteprotocol.h"
+#include "resultsproxy.h"
+#include "workerprotocol.h"
+#include <QFileInfo>
+#include <QProcessEnvironment>
 #include <QStringBuilder>
 #include <QScrollBar>
+#include <QTextStream>
 #include <QTime>
+#include <algorithm>
+#ifdef Q_OS_UNIX
+#include <signal.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
+namespace
+{
+// Selections only read their models, so a hard link is as good as a copy
+bool linkOrCopy(const QString& from, const QString& to, bool *copied)
+{
+#ifdef Q_OS_UNIX
+    if (::link(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0)
+        return true;
+#endif
+    *copied = true;
+    return QFile::copy(from, to);
+}
+}
+
 
 void MainWindow::onCaptureCleanModelsOutput()
 {
-    if (m_pCleanProcess)
-    {
-        QString actionVerbPast = tr("Cleaned");
-        QString actionVerbPresent = tr("Cleaning");
-        QIcon actionIcon = m_iconCleaningMDL;
-        if (ui->decompileCheck->isChecked())
-        {
-            actionVerbPast = "Decompiled";
-            actionVerbPresent = "Decompiling";
-            actionIcon = m_iconDecompilingMDL;
-        }
-        auto outPut = QString::fromStdString(m_pCleanProcess->readAllStandardOutput().toStdString());
+    CleanWorker *worker = workerFor(sender());
+    if (!worker)
+        return;
+    drainWorker(worker, QProcess::StandardOutput);
+    if (worker->idle)
+        settleJobs();
+}
+
+// Read as it comes so a chatty CLI never stalls on a full pipe, and so every
+// warning lands with the model in flight
+void MainWindow::onCaptureCleanModelsErrors()
+{
+    CleanWorker *worker = workerFor(sender());
+    if (!worker)
+        return;
+    drainWorker(worker, QProcess::StandardError);
+    if (worker->idle)
+        settleJobs();
+}
+
+void MainWindow::drainWorker(CleanWorker *worker, QProcess::ProcessChannel channel)
+{
+    // Output arrives in arbitrary chunks, only complete lines are parsed
+    const bool fromStderr = channel == QProcess::StandardError;
+    QByteArray &partialLine = fromStderr ? worker->partialErrorLine : worker->partialLine;
+    partialLine += fromStderr ? worker->process->readAllStandardError() : worker->process->readAllStandardOutput();
+    const int lastNewline = partialLine.lastIndexOf('\n');
+    if (lastNewline < 0)
+        return;
+    const QString outPut = QString::fromUtf8(partialLine.constData(), lastNewline);
+    partialLine.remove(0, lastNewline + 1);
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 2))
-        QStringList lines = outPut.split( "\n", Qt::SkipEmptyParts );
+    QStringList lines = outPut.split( "\n", Qt::SkipEmptyParts );
 #else
-        QStringList lines = outPut.split( "\n", QString::SkipEmptyParts );
+    QStringList lines = outPut.split( "\n", QString::SkipEmptyParts );
 #endif
-        foreach( QString line, lines )
-        {
-            if (line == ".")
-                continue;
-            QRegExp rx_dot(R"(^((.)\2+)+$)");
-            auto pos = rx_dot.indexIn(line);
-            if (pos > -1)
-                continue;
-            QString sStatus;
-            QString outputHtml;
-            QRegExp rx_reading("Attempting to read (.*)");
-            pos = rx_reading.indexIn(line);
-            if (pos > -1)
-            {
-                m_cleanTimer.start();
-                m_sCurrentModel = rx_reading.cap(1).trimmed();
-                sStatus = tr("Reading ") % m_sCurrentModel;
-                m_pCleanStatus->setText(sStatus);
-                m_pStatusProgress->setVisible(true);
-                outputHtml = "<p><span style=\"color:blue;\"><b>" % line % "</b></span></p><br>";
-                ui->debugTextBrowser->insertHtml(outputHtml);
-                auto sb = ui->debugTextBrowser->verticalScrollBar();
-                sb->setValue(sb->maximum());
-                auto *twiReadingMDL = new QTableWidgetItem();
-                twiReadingMDL->setIcon(m_iconReadingMDL);
-                twiReadingMDL->setToolTip("Reading");
-                twiReadingMDL->setText(tr("Reading"));
-                ui->filesTable->setItem(findModelRow(m_sCurrentModel), 2, twiReadingMDL);
-                ui->filesTable->scrollToItem(twiReadingMDL);
-                continue;
-            }
-            QRegExp rx_mdl("MDL\\s(.*)\\sloaded.");
-            pos = rx_mdl.indexIn(line);
-            if (pos > -1)
-            {
-                sStatus = tr(actionVerbPresent.toStdString().c_str()) % " " % m_sCurrentModel;
-                m_pCleanStatus->setText(sStatus);
-                m_pStatusProgress->setVisible(true);
-                outputHtml = "<p><span style=\"color:blue;\"><b>" % line % "</b></span></p><br>";
-                ui->debugTextBrowser->insertHtml(outputHtml);
-                auto sb = ui->debugTextBrowser->verticalScrollBar();
-                sb->setValue(sb->maximum());
-                auto *twiCleaningMDL = new QTableWidgetItem();
-                twiCleaningMDL->setText(tr(actionVerbPresent.toStdString().c_str()));
-                twiCleaningMDL->setIcon(actionIcon);
-                twiCleaningMDL->setToolTip(tr(actionVerbPresent.toStdString().c_str()));
-                ui->filesTable->setItem(findModelRow(m_sCurrentModel), 2, twiCleaningMDL);
-                continue;
-            }
-            QRegExp rx_bin("Binary file (.*) detected, attempting import.");
-            pos = rx_bin.indexIn(line);
-            if (pos > -1)
+    foreach( QString line, lines )
+        parseWorkerLine(worker, line.trimmed(), fromStderr);
+}
+
+void MainWindow::parseWorkerLine(CleanWorker *worker, const QString& line, bool fromStderr)
+{
+    CleanJob *job = findJob(worker->task.jobId);
+    if (!job)
+        return;
+    QString actionVerbPast = tr("Cleaned");
+    QString actionVerbPresent = tr("Cleaning");
+    QIcon actionIcon = m_iconCleaningMDL;
+    if (worker->task.stage == CleanTask::Decompile)
+    {
+        actionVerbPast = "Decompiled";
+        actionVerbPresent = "Decompiling";
+        actionIcon = m_iconDecompilingMDL;
+    }
+    if (line.isEmpty() || line == ".")
+        return;
+    ++m_metrics.parserLines;
+    if (!fromStderr && worker->persistent && line.startsWith(QLatin1String(WorkerProtocol::DoneLine)))
+    {
+        worker->doneModels.insert(worker->currentModel);
+        ++worker->served;
+        feedNextModel(worker);
+        return;
+    }
+    QRegExp rx_dot(R"(^((.)\2+)+$)");
+    auto pos = rx_dot.indexIn(line);
+    if (pos > -1)
+        return;
+    if (fromStderr)
+        worker->modelErrors += line % "\n";
+    QString sStatus;
+    QString outputHtml;
+    QRegExp rx_reading("Attempting to read (.*)");
+    pos = rx_reading.indexIn(line);
+    if (pos > -1)
+    {
+        worker->timer.start();
+        worker->pausedMs = 0;
+        worker->currentModel = modelKey(worker, rx_reading.cap(1).trimmed());
+        worker->modelErrors.clear();
+        worker->modelFixes.clear();
+        sStatus = tr("Reading ") % worker->currentModel;
+        m_pCleanStatus->setText(sStatus);
+        m_pStatusProgress->setVisible(true);
+        outputHtml = "<p><span style=\"color:blue;\"><b>" % line % "</b></span></p><br>";
+        appendModelLog(job, worker->currentModel, outputHtml, LogIndex::Read, line);
+        auto *twiReadingMDL = new QTableWidgetItem();
+        twiReadingMDL->setIcon(m_iconReadingMDL);
+        twiReadingMDL->setToolTip("Reading");
+        twiReadingMDL->setText(tr("Reading"));
+        job->table->setItem(findModelRow(job, worker->currentModel), 2, twiReadingMDL);
+        job->table->scrollToItem(twiReadingMDL);
+        return;
+    }
+    QRegExp rx_mdl("MDL\\s(.*)\\sloaded.");
+    pos = rx_mdl.indexIn(line);
+    if (pos > -1)
+    {
+        sStatus = tr(actionVerbPresent.toStdString().c_str()) % " " % worker->currentModel;
+        m_pCleanStatus->setText(sStatus);
+        m_pStatusProgress->setVisible(true);
+        outputHtml = "<p><span style=\"color:blue;\"><b>" % line % "</b></span></p><br>";
+        appendModelLog(job, worker->currentModel, outputHtml, LogIndex::Read, line);
+        auto *twiCleaningMDL = new QTableWidgetItem();
+        twiCleaningMDL->setText(tr(actionVerbPresent.toStdString().c_str()));
+        twiCleaningMDL->setIcon(actionIcon);
+        twiCleaningMDL->setToolTip(tr(actionVerbPresent.toStdString().c_str()));
+        job->table->setItem(findModelRow(job, worker->currentModel), 2, twiCleaningMDL);
+        return;
+    }
+    QRegExp rx_bin("Binary file (.*) detected, attempting import.");
+    pos = rx_bin.indexIn(line);
+    if (pos > -1)
+    {
+        sStatus = tr("Decompiling ") % rx_bin.cap(1);
+        m_pStatusProgress->setVisible(true);
+        m_pCleanStatus->setText(sStatus);
+    }
+    QRegExp rx_fixes(R"(Fixes made = (\d+))");
+    pos = rx_fixes.indexIn(line);
+    if (pos > -1)
+    {
+        auto *fixesItem = new QTableWidgetItem(rx_fixes.cap(1));
+        fixesItem->setTextAlignment(Qt::AlignHCenter | Qt::AlignVCenter);
+        if (!settleFixes(job, worker, rx_fixes.cap(1).toInt()))
+            fixesItem->setToolTip(tr("Left out of the fix breakdown, the detail lines do not add up to this count"));
+        job->table->setItem(findModelRow(job, worker->currentModel), 3, fixesItem);
+    }
+    QRegExp rx_written(R"((.*) written.)");
+    pos = rx_written.indexIn(line);
+    if (pos > -1)
+    {
+        outputHtml = "<p><span style=\"color:green;\"><b>" % line % "</b></span></p><br>";
+        appendModelLog(job, worker->currentModel, outputHtml, LogIndex::Written, line);
+        auto *twiCleanTimer = new QTableWidgetItem();
+        twiCleanTimer->setText(QTime(0,0).addMSecs(modelElapsed(worker)).toString("mm:ss.zzz"));
+        twiCleanTimer->setTextAlignment(Qt::AlignCenter);
+        job->table->setItem(findModelRow(job, worker->currentModel), 4, twiCleanTimer);
+        worker->doneModels.insert(worker->currentModel);
+        addBusyTime(worker);
+        if (!worker->task.cleanOutDir.isEmpty())
+        {
+            // Only half way there, the clean stage picks it up from here
+            auto *twiDecompiled = new QTableWidgetItem();
+            twiDecompiled->setText(tr("Decompiled"));
+            twiDecompiled->setIcon(m_iconDecompilingMDL);
+            twiDecompiled->setToolTip(tr("Waiting to be cleaned"));
+            job->table->setItem(findModelRow(job, worker->currentModel), 2, twiDecompiled);
+            return;
+        }
+        auto *twiVerifying = new QTableWidgetItem();
+        twiVerifying->setText(tr("Verifying"));
+        twiVerifying->setIcon(actionIcon);
+        twiVerifying->setToolTip(tr("Checking the written model before moving it into place"));
+        job->table->setItem(findModelRow(job, worker->currentModel), 2, twiVerifying);
+        commitWrittenModel(job, worker, rx_written.cap(1).trimmed());
+        return;
+    }
+    QRegExp rx_error(R"(\*\*\* Cannot(.*)|\*\* Load failed(.*))");
+    pos = rx_error.indexIn(line);
+    const LogIndex::Severity severity = pos > -1 ? LogIndex::Error : LogIndex::Other;
+    if (pos > -1)
+    {
+        worker->doneModels.insert(worker->currentModel);
+        job->failed++;
+        ++m_metrics.modelsFailed;
+        addBusyTime(worker);
+        updateJobCounters(job);
+        outputHtml = "<p><span style=\"color:red;\"><b>" % line % "</b></span></p><br>";
+        auto *twiCleanError = new QTableWidgetItem();
+        twiCleanError->setText(tr("Failed"));
+        twiCleanError->setIcon(m_iconCleanError);
+        twiCleanError->setData(ResultsProxyModel::FailedRole, true);
+        twiCleanError->setToolTip(tr("Failed"));
+        auto *twiCleanTimer = new QTableWidgetItem();
+        twiCleanTimer->setText(QTime(0,0).addMSecs(modelElapsed(worker)).toString("mm:ss.zzz"));
+        twiCleanTimer->setTextAlignment(Qt::AlignCenter);
+        job->table->setItem(findModelRow(job, worker->currentModel), 2, twiCleanError);
+        job->table->setItem(findModelRow(job, worker->currentModel), 4, twiCleanTimer);
+    }
+    else if (fromStderr)
+    {
+        outputHtml = "<span style=\"color:darkorange;\">" % line.toHtmlEscaped() % "</span><br>";
+    }
+    else
+    {
+        outputHtml = "<span>" % line % "</span><br>";
+        // Detail lines between loading and writing a model describe its fixes
+        if (!worker->currentModel.isEmpty() && !worker->doneModels.contains(worker->currentModel))
+        {
+            const int category = FixCatalog::categorize(line);
+            if (category >= 0)
             {
-                sStatus = tr("Decompiling ") % rx_bin.cap(1);
-                m_pStatusProgress->setVisible(true);
-                m_pCleanStatus->setText(sStatus);
+                if (worker->modelFixes.isEmpty())
+                    worker->modelFixes.resize(FixCatalog::categoryCount());
+                if (worker->modelFixes.at(category) < 0xffff)
+                    ++worker->modelFixes[category];
             }
-            QRegExp rx_fixes(R"(Fixes made = (\d+))");
-            pos = rx_fixes.indexIn(line);
-            if (pos > -1)
+        }
+    }
+    appendModelLog(job, worker->currentModel, outputHtml, severity, line);
+}
+
+void MainWindow::doClean()
+{
+    if (m_bCleanRunning)
+    {
+        abortJob(m_pViewJob);
+        ui->debugTextBrowser->append(tr("Aborted"));
+        ui->decompileCheck->setEnabled(true);
+        ui->dedupeCheck->setEnabled(true);
+        settleJobs();
+        return;
+    }
+    if (m_bProbingCli)
+    {
+        appendLog(ui->debugTextBrowser, tr("Still looking for ") % m_sBinaryName % tr(", try again in a moment.<br>"));
+        return;
+    }
+    // Ranges into the log being cleared would point at the wrong lines
+    for (CleanJob *previous : qAsConst(m_jobs))
+    {
+        if (previous->log == ui->debugTextBrowser)
+            previous->logSlices.clear();
+    }
+    ui->debugTextBrowser->clear();
+    ui->debugTextBrowser->setExtraSelections(QList<QTextEdit::ExtraSelection>());
+    appendLog(ui->debugTextBrowser, tr("Running cleanmodels<br>"));
+    // The listing shown in the main window is cleaned as it is, duplicates
+    // included, and reports straight into filesTable
+    CleanJob *job = newJob();
+    job->entries = m_modelEntries;
+    job->duplicates = m_duplicates;
+    job->duplicateOf = m_duplicateOf;
+    job->stats = m_modelStats;
+    job->table = ui->filesTable;
+    job->items = m_modelItems;
+    job->log = ui->debugTextBrowser;
+    addJob(job);
+    if (!startJob(job))
+    {
+        settleJobs();
+        return;
+    }
+    m_pViewJob = job;
+    m_bCleanRunning = true;
+    ui->decompileCheck->setEnabled(false);
+    ui->dedupeCheck->setEnabled(false);
+    updateJobCounters(job);
+    ui->cleanButton->setText(tr("Abort"));
+    ui->cleanButton->setIcon(m_iconAbortButton);
+    settleJobs();
+}
+
+// Watch mode builds the tasks of every batch apart, batch keeps the run
+// folders of later batches from clashing with those still in use
+QList<CleanTask> MainWindow::buildCleanTasks(const CleanJob *job, const QVector<ModelEntry>& jobEntries, int batch) const
+{
+    QList<CleanTask> tasks;
+    QDir cwd(QDir::currentPath());
+    // Models are written to a staging folder first, for archives that one
+    // lives in the run folder
+    const bool archiveSink = ErfArchive::isArchivePath(job->outDir);
+    const QString outRoot = archiveSink ? job->runDir->filePath("out") : job->stageDir->path();
+    const bool decompileOnly = job->decompileOnly;
+    // Binary models are decompiled by their own runs first and the result is
+    // handed to the clean runs, so both stages work side by side
+    auto stageOf = [decompileOnly](const ModelEntry& entry) {
+        return decompileOnly || !entry.isASCII ? CleanTask::Decompile : CleanTask::Clean;
+    };
+    // Profiled models go heaviest first, so the chunks still running at the
+    // end of the job are the quick ones
+    QVector<ModelEntry> entries = jobEntries;
+    if (!job->stats.isEmpty())
+    {
+        std::stable_sort(entries.begin(), entries.end(), [job](const ModelEntry& a, const ModelEntry& b) {
+            return job->stats.value(a.relPath).faces > job->stats.value(b.relPath).faces;
+        });
+    }
+    bool pipelined = false;
+    for (const ModelEntry &entry : entries)
+    {
+        if (!decompileOnly && !entry.isASCII && !job->duplicateOf.contains(entry.relPath))
+            pipelined = true;
+    }
+    const QString serial = batch ? QString::number(batch) % "_" : QString();
+    auto finishTask = [job, decompileOnly, &tasks, &serial](CleanTask task) {
+        task.jobId = job->id;
+        if (task.stage == CleanTask::Decompile && !decompileOnly)
+        {
+            task.cleanOutDir = task.outDir;
+            task.outDir = job->runDir->filePath("decompiled_" % serial % QString::number(tasks.count()));
+        }
+        tasks.append(task);
+    };
+
+    if (job->inArchive)
+    {
+        // Archive models are written out a chunk at a time just before the
+        // run that needs them and removed again right after it, so the
+        // archive is never extracted as a whole
+        QVector<int> selected[2];
+        for (const ModelEntry &entry : entries)
+        {
+            if (!job->duplicateOf.contains(entry.relPath))
+                selected[stageOf(entry)].append(entry.archiveIndex);
+        }
+        const int chunkSize = 64;
+        for (int stage = CleanTask::Clean; stage <= CleanTask::Decompile; ++stage)
+        {
+            for (int first = 0; first < selected[stage].count(); first += chunkSize)
             {
-                auto *fixesItem = new QTableWidgetItem(rx_fixes.cap(1));
-                fixesItem->setTextAlignment(Qt::AlignHCenter | Qt::AlignVCenter);
-                ui->filesTable->setItem(findModelRow(m_sCurrentModel), 3, fixesItem);
+                CleanTask task;
+                task.stage = CleanTask::Stage(stage);
+                task.inDir = job->runDir->filePath(QString("archive_%1").arg(tasks.count()));
+                task.outDir = outRoot;
+                task.pattern = "*.mdl";
+                task.generatedOptions = true;
+                task.archiveEntries = selected[stage].mid(first, chunkSize);
+                finishTask(task);
             }
-            QRegExp rx_written(R"((.*) written.)");
-            pos = rx_written.indexIn(line);
-            if (pos > -1)
+        }
+        return tasks;
+    }
+
+    const bool skipDuplicates = !job->duplicateOf.isEmpty();
+    const int workers = decompileOnly ? m_nDecompileWorkers : m_nCleanWorkers;
+    if (!job->recursive && !job->watched && !skipDuplicates && !pipelined && workers <= 1 && m_agents.isEmpty())
+    {
+        // A flat run reads the input folder directly
+        CleanTask task;
+        task.stage = decompileOnly ? CleanTask::Decompile : CleanTask::Clean;
+        task.jobId = job->id;
+        task.inDir = cwd.absoluteFilePath(job->inDir);
+        task.outDir = outRoot;
+        task.pattern = job->pattern;
+        task.generatedOptions = true;
+        tasks.append(task);
+        return tasks;
+    }
+
+    // Everything else runs from selection folders that link a chunk of the
+    // models of one input folder, each writing to the same relative folder
+    // below the output directory
+    const int chunkSize = 16;
+    QString inRoot = cwd.absoluteFilePath(job->inDir);
+    QList<CleanTask> selections;
+    QHash<QString, int> openSelection[2];
+    for (const ModelEntry &entry : entries)
+    {
+        if (job->duplicateOf.contains(entry.relPath))
+            continue;
+        const int stage = stageOf(entry);
+        int slash = entry.relPath.lastIndexOf('/');
+        QString relDir = slash < 0 ? QString() : entry.relPath.left(slash);
+        int index = openSelection[stage].value(relDir, -1);
+        if (index < 0 || selections.at(index).stagedFiles.count() >= chunkSize)
+        {
+            CleanTask task;
+            task.stage = CleanTask::Stage(stage);
+            task.relDir = relDir;
+            task.sourceDir = relDir.isEmpty() ? inRoot : inRoot % "/" % relDir;
+            task.outDir = relDir.isEmpty() ? outRoot : outRoot % "/" % relDir;
+            task.pattern = job->pattern;
+            task.generatedOptions = true;
+            index = selections.count();
+            openSelection[stage].insert(relDir, index);
+            selections.append(task);
+        }
+        selections[index].stagedFiles.append(entry.relPath.mid(slash + 1));
+        selections[index].stagedBytes += entry.size;
+    }
+    for (CleanTask task : qAsConst(selections))
+    {
+        task.inDir = selectionFolder(job, "selection_" % serial % QString::number(tasks.count()));
+        finishTask(task);
+    }
+    return tasks;
+}
+
+QString MainWindow::writeTaskOptions(CleanJob *job, const CleanTask& task)
+{
+    if (!job->runDir || !job->runDir->isValid() || job->options.isEmpty())
+        return QString();
+    QString options = job->options;
+    options = withUserOption(options, "g_indir", task.inDir, true);
+    options = withUserOption(options, "g_outdir", task.outDir, true);
+    options = withUserOption(options, "g_pattern", task.pattern, true);
+
+    QString optionsPath = job->runDir->filePath(QString("task_%1.pl").arg(++job->taskSerial));
+    QFile out(optionsPath);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Text))
+        return QString();
+    QTextStream stream(&out);
+    stream << options;
+    return optionsPath;
+}
+
+bool MainWindow::inputIsArchive() const
+{
+    return m_pInArchive && m_pInArchive->isOpen() && ErfArchive::isArchivePath(m_sInDir);
+}
+
+bool MainWindow::writeArchiveEntries(const CleanJob *job, const CleanTask& task)
+{
+    if (!job->inArchive || !QDir().mkpath(task.inDir))
+        return false;
+    for (int index : task.archiveEntries)
+    {
+        QFile out(task.inDir % "/" % job->inArchive->resourceFileName(index));
+        if (!out.open(QIODevice::WriteOnly) || out.write(job->inArchive->resourceData(index)) < 0)
+            return false;
+    }
+    return true;
+}
+
+QString MainWindow::selectionFolder(const CleanJob *job, const QString& name) const
+{
+    return job->selectionDir ? job->selectionDir->filePath(name) : job->runDir->filePath(name);
+}
+
+bool MainWindow::stageSelection(CleanJob *job, const CleanTask& task)
+{
+    if (!QDir().mkpath(task.inDir))
+        return false;
+    bool copied = false;
+    for (const QString &fileName : task.stagedFiles)
+    {
+        if (!linkOrCopy(task.sourceDir % "/" % fileName, task.inDir % "/" % fileName, &copied))
+            return false;
+    }
+    if (copied && !job->selectionsCopied)
+    {
+        job->selectionsCopied = true;
+        appendJobLog(job, tr("Models could not be hard linked from ") % task.sourceDir % tr(", they are copied into ") % QFileInfo(task.inDir).path() % tr(" instead.<br>"));
+    }
+    return true;
+}
+
+bool MainWindow::openOutputArchive(CleanJob *job)
+{
+    if (!ErfArchive::isArchivePath(job->outDir))
+        return true;
+    QString archivePath = QDir(QDir::currentPath()).absoluteFilePath(job->outDir);
+    job->outArchive = new ErfWriter(archivePath);
+    if (!job->outArchive->open(ErfWriter::fileTypeForPath(archivePath)))
+        return false;
+    if (job->inArchive)
+        job->outArchive->setLocalizedStrings(job->inArchive->languageCount(), job->inArchive->localizedStrings(), job->inArchive->descriptionStrRef());
+    return true;
+}
+
+void MainWindow::commitWrittenModel(CleanJob *job, const CleanWorker *worker, const QString& reportedPath)
+{
+    const QFileInfo reported(reportedPath);
+    QString fileName = reported.suffix().isEmpty() ? QFileInfo(worker->currentModel).fileName() : reported.fileName();
+    QString writtenPath = worker->task.outDir % "/" % fileName;
+    if (!QFileInfo::exists(writtenPath) && reported.isAbsolute() && reported.isFile())
+        writtenPath = reportedPath;
+    const QString suffix = QFileInfo(fileName).suffix();
+    const QString outRoot = QDir(QDir::currentPath()).absoluteFilePath(job->outDir);
+
+    CommitJob commit;
+    commit.jobId = job->id;
+    commit.modelKey = worker->currentModel;
+    commit.stagedPath = writtenPath;
+    commit.resRef = QFileInfo(fileName).completeBaseName();
+    commit.resType = ErfArchive::typeForExtension(suffix);
+    if (!commit.resType)
+        commit.resType = ErfArchive::ResTypeMdl;
+    commit.archive = job->outArchive;
+    if (!job->outArchive)
+        commit.finalPath = outRoot % "/" % (worker->task.relDir.isEmpty() ? fileName : worker->task.relDir % "/" % fileName);
+    const QStringList duplicates = job->duplicates.value(worker->currentModel);
+    for (const QString &duplicate : duplicates)
+    {
+        CommitCopy copy;
+        copy.modelKey = duplicate;
+        copy.resRef = QFileInfo(duplicate).completeBaseName();
+        if (!job->outArchive)
+        {
+            const int slash = duplicate.lastIndexOf('/');
+            copy.finalPath = (slash < 0 ? outRoot : outRoot % "/" % duplicate.left(slash)) % "/" % copy.resRef % "." % suffix;
+        }
+        commit.copies.append(copy);
+    }
+    ++job->commitsPending;
+    m_pCommitter->commit(commit);
+}
+
+void MainWindow::onModelCommitted(int jobId, const QString& modelKey, const QStringList& copies, const QString& error)
+{
+    CleanJob *job = findJob(jobId);
+    if (!job)
+        return;
+    --job->commitsPending;
+    const QString actionVerbPast = job->decompileOnly ? tr("Decompiled") : tr("Cleaned");
+    if (!error.isEmpty())
+    {
+        job->failed++;
+        ++m_metrics.modelsFailed;
+        updateJobCounters(job);
+        QString errorMsg = "<p><span style=\"color:red;\"><b>" % error % "</b></span></p><br>";
+        appendModelLog(job, modelKey, errorMsg, LogIndex::Error, error);
+        auto *twiCleanError = new QTableWidgetItem();
+        twiCleanError->setText(tr("Failed"));
+        twiCleanError->setIcon(m_iconCleanError);
+        twiCleanError->setData(ResultsProxyModel::FailedRole, true);
+        twiCleanError->setToolTip(error);
+        job->table->setItem(findModelRow(job, modelKey), 2, twiCleanError);
+    }
+    else
+    {
+        job->cleaned += 1 + copies.count();
+        m_metrics.modelsDone += 1 + copies.count();
+        const QTableWidgetItem *fileItem = job->items.value(modelKey);
+        if (const QTableWidgetItem *sizeItem = fileItem ? job->table->item(fileItem->row(), 1) : nullptr)
+            m_metrics.bytesProcessed += sizeItem->text().toLongLong();
+        updateJobCounters(job);
+        for (const QString &copy : copies)
+        {
+            auto *twiCopied = new QTableWidgetItem();
+            twiCopied->setText(actionVerbPast);
+            twiCopied->setIcon(m_iconCleanSuccess);
+            twiCopied->setToolTip(tr("Copied from ") % modelKey);
+            job->table->setItem(findModelRow(job, copy), 2, twiCopied);
+        }
+        auto *twiCleanSuccess = new QTableWidgetItem();
+        twiCleanSuccess->setText(actionVerbPast);
+        twiCleanSuccess->setIcon(m_iconCleanSuccess);
+        twiCleanSuccess->setToolTip(actionVerbPast);
+        job->table->setItem(findModelRow(job, modelKey), 2, twiCleanSuccess);
+    }
+    settleJobs();
+}
+
+void MainWindow::finishOutputArchive(CleanJob *job)
+{
+    if (!job->outArchive)
+        return;
+    if (job->aborted || job->state == CleanJob::Failed)
+    {
+        job->outArchive->cancel();
+    }
+    else
+    {
+        if (job->inArchive)
+        {
+            // Everything that was not replaced by a cleaned model is copied
+            // across straight from the source mapping
+            const QVector<ErfEntry> &resources = job->inArchive->entries();
+            for (int i = 0; i < resources.size(); ++i)
             {
-                m_nMdlsCleaned++;
-                ui->mdlsCleanedLabel->setText("Files " % actionVerbPast % ": " % QString::number(m_nMdlsCleaned));
-                outputHtml = "<p><span style=\"color:green;\"><b>" % line % "</b></span></p><br>";
-                ui->debugTextBrowser->insertHtml(outputHtml);
-                auto sb = ui->debugTextBrowser->verticalScrollBar();
-                sb->setValue(sb->maximum());
-                auto *twiCleanSuccess = new QTableWidgetItem();
-                twiCleanSuccess->setText(tr(actionVerbPast.toStdString().c_str()));
-                twiCleanSuccess->setIcon(m_iconCleanSuccess);
-                twiCleanSuccess->setToolTip(tr(actionVerbPast.toStdString().c_str()));
-                auto *twiCleanTimer = new QTableWidgetItem();
-                twiCleanTimer->setText(QTime(0,0).addMSecs(m_cleanTimer.elapsed()).toString("mm:ss.zzz"));
-                twiCleanTimer->setTextAlignment(Qt::AlignCenter);
-                ui->filesTable->setItem(findModelRow(m_sCurrentModel), 2, twiCleanSuccess);
-                ui->filesTable->setItem(findModelRow(m_sCurrentModel), 4, twiCleanTimer);
-                continue;
+                const ErfEntry &entry = resources.at(i);
+                if (!job->outArchive->contains(entry.resRef, entry.resType) &&
+                    !job->outArchive->addResource(entry.resRef, entry.resType, job->inArchive->resourceData(i)))
+                    break;
             }
-            QRegExp rx_error(R"(\*\*\* Cannot(.*)|\*\* Load failed(.*))");
-            pos = rx_error.indexIn(line);
-            if (pos > -1)
+        }
+        QString resultMsg;
+        if (job->outArchive->commit())
+            resultMsg = "<p><span style=\"color:green;\"><b>" % job->outDir % tr(" written with ") % QString::number(job->outArchive->count()) % tr(" resources.") % "</b></span></p><br>";
+        else
+            resultMsg = "<p><span style=\"color:red;\">" % tr("Could not write archive ") % job->outDir % ": " % job->outArchive->errorString() % "</span></p><br>";
+        appendJobLog(job, resultMsg);
+    }
+    delete job->outArchive;
+    job->outArchive = nullptr;
+}
+
+bool MainWindow::startTask(CleanTask task, int agent)
+{
+    CleanJob *job = findJob(task.jobId);
+    if (!job)
+        return false;
+    QStringList args;
+    if (task.stage == CleanTask::Decompile)
+        args<<"-d";
+    if (!task.archiveEntries.isEmpty() && !writeArchiveEntries(job, task))
+        return false;
+    if (!task.stagedFiles.isEmpty())
+    {
+        // A chunk read ahead runs straight from its copy in RAM
+        const QString prefetched = m_pPrefetcher->take(task.inDir);
+        if (!prefetched.isEmpty())
+            task.inDir = prefetched;
+        else if (!stageSelection(job, task))
+            return false;
+    }
+    // Chunks for remote agents always start a process of their own
+    const bool persistent = m_bPersistentWorkers && agent < 0;
+    if (persistent)
+    {
+        // A worker of the same job and stage between chunks already has the
+        // options loaded, it gets the models of this chunk next
+        for (CleanWorker *worker : qAsConst(m_workers))
+        {
+            if (worker->idle && !worker->retiring && worker->task.jobId == task.jobId && worker->task.stage == task.stage)
             {
-                m_nMdlsFailed++;
-                ui->mdlsFailedLabel->setText("Failures: " % QString::number(m_nMdlsFailed));
-                outputHtml = "<p><span style=\"color:red;\"><b>" % line % "</b></span></p><br>";
-                auto *twiCleanError = new QTableWidgetItem();
-                twiCleanError->setText(tr("Failed"));
-                twiCleanError->setIcon(m_iconCleanError);
-                twiCleanError->setToolTip(tr("Failed"));
-                auto *twiCleanTimer = new QTableWidgetItem();
-                twiCleanTimer->setText(QTime(0,0).addMSecs(m_cleanTimer.elapsed()).toString("mm:ss.zzz"));
-                twiCleanTimer->setTextAlignment(Qt::AlignCenter);
-                ui->filesTable->setItem(findModelRow(m_sCurrentModel), 2, twiCleanError);
-                ui->filesTable->setItem(findModelRow(m_sCurrentModel), 4, twiCleanTimer);
+                QDir().mkpath(task.outDir);
+                worker->task = task;
+                worker->idle = false;
+                worker->feed = taskModels(job, task);
+                feedNextModel(worker);
+                return true;
             }
-            else
+        }
+        args<<WorkerProtocol::ServeOption;
+    }
+    if (task.generatedOptions)
+    {
+        QString optionsPath = writeTaskOptions(job, task);
+        if (optionsPath.isEmpty())
+            return false;
+        QDir().mkpath(task.outDir);
+        args<<optionsPath;
+    }
+    else if (task.stage == CleanTask::Clean)
+        args<<"last_dirs.pl";
+    QString program = m_sBinaryPath;
+    if (agent >= 0)
+    {
+        args.prepend(m_agents.at(agent).address);
+        args.prepend(RemoteProtocol::RemoteOption);
+        program = m_sAgentPath;
+        ++m_agents[agent].dispatched;
+    }
+
+    auto *worker = new CleanWorker;
+    worker->task = task;
+    // Slots are reused, so the metrics keep one series per slot rather than
+    // one per process
+    QSet<int> usedSlots;
+    for (const CleanWorker *running : qAsConst(m_workers))
+        usedSlots.insert(running->slot);
+    while (usedSlots.contains(worker->slot))
+        ++worker->slot;
+    if (agent >= 0)
+        worker->agent = m_agents.at(agent).address;
+    worker->process = new LimitedProcess(m_processLimits, this);
+    worker->process->setWorkingDirectory(QDir::currentPath());
+    if (agent >= 0)
+    {
+        QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+        environment.insert(RemoteProtocol::TokenVariable, m_sAgentToken);
+        worker->process->setProcessEnvironment(environment);
+    }
+    QObject::connect(worker->process, static_cast<void(QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished), this, &MainWindow::onCleanFinished);
+    QObject::connect(worker->process, SIGNAL(readyReadStandardOutput()), this, SLOT(onCaptureCleanModelsOutput()));
+    QObject::connect(worker->process, SIGNAL(readyReadStandardError()), this, SLOT(onCaptureCleanModelsErrors()));
+    m_workers.append(worker);
+    worker->process->start(program,args,QIODevice::ReadWrite);
+    if (!worker->process->waitForStarted())
+    {
+        m_workers.removeOne(worker);
+        worker->process->disconnect(this);
+        worker->process->deleteLater();
+        delete worker;
+        return false;
+    }
+    if (persistent)
+    {
+        worker->persistent = true;
+        worker->feed = taskModels(job, task);
+        feedNextModel(worker);
+    }
+    return true;
+}
+
+QStringList MainWindow::taskModels(const CleanJob *job, const CleanTask& task) const
+{
+    if (!task.stagedFiles.isEmpty())
+        return task.stagedFiles;
+    QStringList models;
+    if (!task.archiveEntries.isEmpty())
+    {
+        for (int index : task.archiveEntries)
+            models.append(job->inArchive->resourceFileName(index));
+        return models;
+    }
+    return QDir(task.inDir).entryList(QStringList(task.pattern), QDir::Files, QDir::Name);
+}
+
+// Hands a persistent worker the next model of its chunk, or lets it wait
+// for the next chunk once all of them are done
+void MainWindow::feedNextModel(CleanWorker *worker)
+{
+    if (worker->feed.isEmpty())
+    {
+        if (CleanJob *job = findJob(worker->task.jobId))
+            completeTask(job, worker->task);
+        worker->idle = true;
+        worker->currentModel.clear();
+        worker->doneModels.clear();
+        return;
+    }
+    const QString fileName = worker->feed.takeFirst();
+    worker->currentModel = worker->task.relDir.isEmpty() ? fileName : worker->task.relDir % "/" % fileName;
+    worker->modelErrors.clear();
+    worker->timer.start();
+    worker->pausedMs = 0;
+    QByteArray request = QFile::encodeName(worker->task.inDir % "/" % fileName);
+    request += '\t';
+    request += QFile::encodeName(worker->task.outDir);
+    request += '\n';
+    worker->process->write(request);
+}
+
+// Local workers only, remote agents have slots of their own
+int MainWindow::runningWorkers(CleanTask::Stage stage) const
+{
+    int running = 0;
+    for (const CleanWorker *worker : m_workers)
+    {
+        if (worker->task.stage == stage && !worker->idle && worker->agent.isEmpty())
+            ++running;
+    }
+    return running;
+}
+
+int MainWindow::busyWorkers() const
+{
+    int busy = 0;
+    for (const CleanWorker *worker : m_workers)
+    {
+        if (!worker->idle && worker->agent.isEmpty())
+            ++busy;
+    }
+    return busy;
+}
+
+int MainWindow::jobWorkers(int jobId) const
+{
+    int running = 0;
+    for (const CleanWorker *worker : m_workers)
+    {
+        if (worker->task.jobId == jobId)
+            ++running;
+    }
+    return running;
+}
+
+int MainWindow::agentWorkers(const QString& address) const
+{
+    int running = 0;
+    for (const CleanWorker *worker : m_workers)
+    {
+        if (worker->agent == address)
+            ++running;
+    }
+    return running;
+}
+
+// The remote agent with the most of its slots free, agents with the same
+// share take turns. A lost agent sits out a while before it is tried again.
+int MainWindow::pickAgent() const
+{
+    const qint64 lostPauseMs = 60000;
+    int best = -1;
+    double bestLoad = 0;
+    for (int i = 0; i < m_agents.count(); ++i)
+    {
+        const RemoteAgent &agent = m_agents.at(i);
+        if (agent.lost.isValid() && agent.lost.elapsed() < lostPauseMs)
+            continue;
+        const int running = agentWorkers(agent.address);
+        if (running >= agent.slots)
+            continue;
+        const double load = double(running) / agent.slots;
+        if (best < 0 || load < bestLoad || (load == bestLoad && agent.dispatched < m_agents.at(best).dispatched))
+        {
+            best = i;
+            bestLoad = load;
+        }
+    }
+    return best;
+}
+
+void MainWindow::markAgentLost(const QString& address)
+{
+    for (RemoteAgent &agent : m_agents)
+    {
+        if (agent.address != address)
+            continue;
+        if (!agent.lost.isValid() || agent.lost.elapsed() > 1000)
+            appendLog(ui->debugTextBrowser, "<p><span style=\"color:red;\">" % tr("Lost remote agent ") % address % tr(", its models go to the other workers.") % "</span></p><br>");
+        agent.lost.start();
+    }
+}
+
+// The highest priority job with work for the stage. Jobs of equal priority
+// take turns, the one with the fewest workers goes next.
+CleanJob *MainWindow::nextJob(CleanTask::Stage stage, bool handoffFull) const
+{
+    CleanJob *next = nullptr;
+    int nextWorkers = 0;
+    for (CleanJob *job : m_jobs)
+    {
+        if (job->state != CleanJob::Running)
+            continue;
+        if (stage == CleanTask::Clean && job->cleanQueue.isEmpty() && job->handoffQueue.isEmpty())
+            continue;
+        if (stage == CleanTask::Decompile &&
+            (job->decompileQueue.isEmpty() || (handoffFull && !job->decompileQueue.first().cleanOutDir.isEmpty())))
+            continue;
+        const int workers = jobWorkers(job->id);
+        if (!next || job->priority > next->priority || (job->priority == next->priority && workers < nextWorkers))
+        {
+            next = job;
+            nextWorkers = workers;
+        }
+    }
+    return next;
+}
+
+// False when a worker could not be started
+bool MainWindow::scheduleTasks()
+{
+    if (m_bPaused)
+        return true;
+    activateJobs();
+    // Decompiled models wait in short hand-off queues, the decompile stage
+    // holds back whenever the clean stage cannot keep up with it
+    int agentSlots = 0;
+    for (const RemoteAgent &agent : qAsConst(m_agents))
+        agentSlots += agent.slots;
+    const int handoffLimit = 2 * (m_nCleanWorkers + agentSlots);
+    // Local workers go first, remote agents take the chunks left over
+    int cleaning = runningWorkers(CleanTask::Clean);
+    for (;;)
+    {
+        const bool local = cleaning < m_nCleanWorkers && busyWorkers() < m_nWorkerBudget;
+        const int agent = local ? -1 : pickAgent();
+        if (!local && agent < 0)
+            break;
+        CleanJob *job = nextJob(CleanTask::Clean, false);
+        if (!job)
+            break;
+        CleanTask task = !job->handoffQueue.isEmpty() ? job->handoffQueue.takeFirst() : job->cleanQueue.takeFirst();
+        if (!startTask(task, agent))
+            return false;
+        if (local)
+            ++cleaning;
+    }
+    int decompiling = runningWorkers(CleanTask::Decompile);
+    int handoffs = 0;
+    for (const CleanJob *job : qAsConst(m_jobs))
+        handoffs += job->handoffQueue.count();
+    for (const CleanWorker *worker : qAsConst(m_workers))
+    {
+        if (!worker->agent.isEmpty() && worker->task.stage == CleanTask::Decompile)
+            ++handoffs;
+    }
+    for (;;)
+    {
+        const bool local = decompiling < m_nDecompileWorkers && busyWorkers() < m_nWorkerBudget;
+        const int agent = local ? -1 : pickAgent();
+        if (!local && agent < 0)
+            break;
+        CleanJob *job = nextJob(CleanTask::Decompile, handoffs + decompiling >= handoffLimit);
+        if (!job)
+            break;
+        if (!startTask(job->decompileQueue.takeFirst(), agent))
+            return false;
+        if (local)
+            ++decompiling;
+        else
+            ++handoffs;
+    }
+    // Persistent workers left without a chunk of their job and stage exit,
+    // watch mode keeps its worker warm for the next model to land
+    for (CleanWorker *worker : qAsConst(m_workers))
+    {
+        const CleanJob *job = findJob(worker->task.jobId);
+        if (worker->idle && !worker->retiring && !(job && job->watched))
+        {
+            worker->retiring = true;
+            worker->process->closeWriteChannel();
+        }
+    }
+    // Whatever is left queued is read ahead for the next pass
+    prefetchUpcoming();
+    return true;
+}
+
+// Reads the chunks next in line ahead of their run, jobs in the order the
+// scheduler takes them
+void MainWindow::prefetchUpcoming()
+{
+    if (m_pPrefetcher->budget() <= 0)
+        return;
+    QList<CleanJob*> jobs;
+    for (CleanJob *job : qAsConst(m_jobs))
+    {
+        if (job->state == CleanJob::Running)
+            jobs.append(job);
+    }
+    std::stable_sort(jobs.begin(), jobs.end(), [](const CleanJob *a, const CleanJob *b) {
+        return a->priority > b->priority;
+    });
+    int workers = m_nCleanWorkers + m_nDecompileWorkers;
+    for (const RemoteAgent &agent : qAsConst(m_agents))
+        workers += agent.slots;
+    const int depth = m_pPrefetcher->depth(workers);
+    // Only the front of each queue, archive and retry chunks are not read ahead
+    const int window = 64;
+    for (const CleanJob *job : qAsConst(jobs))
+    {
+        for (const QList<CleanTask> *queue : {&job->decompileQueue, &job->cleanQueue})
+        {
+            for (int i = 0; i < queue->count() && i < window; ++i)
             {
-                outputHtml = "<span>" % line % "</span><br>";
+                if (m_pPrefetcher->pending() >= depth)
+                    return;
+                const CleanTask &task = queue->at(i);
+                if (task.stagedFiles.isEmpty() || task.stagedBytes <= 0 || m_pPrefetcher->contains(task.inDir))
+                    continue;
+                if (!m_pPrefetcher->request(job->id, task.inDir, task.sourceDir, task.stagedFiles, task.stagedBytes))
+                    return;
             }
-            ui->debugTextBrowser->insertHtml(outputHtml);
-            auto sb = ui->debugTextBrowser->verticalScrollBar();
-            sb->setValue(sb->maximum());
         }
     }
 }
 
-void MainWindow::doClean()
+void MainWindow::onPauseToggled(bool paused)
 {
-    if (m_bCleanRunning)
+    if (!m_bRunActive || paused == m_bPaused)
+        return;
+    m_bPaused = paused;
+    // Stopped workers keep their state, time spent stopped is left out of
+    // the model timers. Where processes cannot be stopped pausing only
+    // holds back the next runs.
+    for (CleanWorker *worker : qAsConst(m_workers))
     {
-        m_pCleanProcess->kill();
-        ui->debugTextBrowser->append(tr("Aborted"));
-        ui->decompileCheck->setEnabled(true);
-        auto *twiCleanAborted = new QTableWidgetItem();
-        twiCleanAborted->setText(tr("Aborted"));
-        twiCleanAborted->setIcon(m_iconAbortButton);
-        twiCleanAborted->setToolTip(tr("Aborted"));
-        ui->filesTable->setItem(findModelRow(m_sCurrentModel), 2, twiCleanAborted);
+#ifdef Q_OS_UNIX
+        ::kill(pid_t(worker->process->processId()), paused ? SIGSTOP : SIGCONT);
+#endif
+        if (paused)
+            worker->pauseTimer.start();
+        else if (worker->pauseTimer.isValid())
+            worker->pausedMs += worker->pauseTimer.elapsed();
+    }
+    ui->actionPause->setText(paused ? tr("Resume") : tr("Pause"));
+    if (paused)
+    {
+        m_pCleanStatus->setText(tr("Paused"));
+        appendLog(ui->debugTextBrowser, tr("Paused<br>"));
         return;
     }
-    connect(m_pCleanProcess, SIGNAL(readyReadStandardOutput()), this, SLOT(onCaptureCleanModelsOutput()));
-    ui->debugTextBrowser->clear();
-    ui->debugTextBrowser->insertHtml(tr("Running cleanmodels<br>"));
-    QStringList args;
-    m_pCleanProcess->setCurrentWriteChannel(QProcess::StandardOutput);
-    m_pCleanProcess->setWorkingDirectory(QDir::currentPath());
-    QString filePattern = ui->filePattern->text();
-    if (ui->decompileCheck->isChecked())
-        args<<"-d";
+    m_pCleanStatus->setText(tr("Resumed"));
+    appendLog(ui->debugTextBrowser, tr("Resumed<br>"));
+    settleJobs();
+}
+
+// CLEANMODELS_METRICS_TEXTFILE and CLEANMODELS_METRICS_PORT turn the
+// metrics on, so unattended hosts need no settings
+void MainWindow::setupMetrics()
+{
+    const QString textfile = QFile::decodeName(qgetenv("CLEANMODELS_METRICS_TEXTFILE"));
+    const int port = qEnvironmentVariableIntValue("CLEANMODELS_METRICS_PORT");
+    if (textfile.isEmpty() && port <= 0)
+        return;
+    m_pMetricsExporter = new MetricsExporter(this);
+    m_pMetricsExporter->setTextfile(textfile);
+    QString error;
+    if (port > 0 && port < 65536 && !m_pMetricsExporter->listen(quint16(port), &error))
+        appendLog(ui->debugTextBrowser, "<p><span style=\"color:red;\">" % tr("Could not serve metrics on port ") % QString::number(port) % ": " % error % "</span></p><br>");
+    m_pMetricsTimer = new QTimer(this);
+    m_pMetricsTimer->setInterval(2000);
+    connect(m_pMetricsTimer, &QTimer::timeout, this, &MainWindow::publishMetrics);
+    m_metricsClock.start();
+    m_pMetricsTimer->start();
+}
+
+void MainWindow::publishMetrics()
+{
+    // A tick that comes late was held up by the event loop
+    const qint64 sinceLast = qMax<qint64>(1, m_metricsClock.restart());
+    m_metrics.eventLoopLagMs = qMax<qint64>(0, sinceLast - m_pMetricsTimer->interval());
+    m_metrics.parserLinesPerSecond = (m_metrics.parserLines - m_nMetricsLines) * 1000.0 / sinceLast;
+    m_nMetricsLines = m_metrics.parserLines;
+
+    m_metrics.queueDepth = 0;
+    m_metrics.modelsInFlight = 0;
+    for (const CleanJob *job : qAsConst(m_jobs))
+    {
+        m_metrics.queueDepth += job->cleanQueue.count() + job->decompileQueue.count() + job->handoffQueue.count();
+        m_metrics.modelsInFlight += job->commitsPending;
+    }
+    m_metrics.workersBusy = busyWorkers();
+    m_metrics.workerModelMs.fill(-1);
+    for (const CleanWorker *worker : qAsConst(m_workers))
+    {
+        while (m_metrics.workerModelMs.count() <= worker->slot)
+            m_metrics.workerModelMs.append(-1);
+        const bool working = !worker->idle && !worker->currentModel.isEmpty() && !worker->doneModels.contains(worker->currentModel);
+        m_metrics.workerModelMs[worker->slot] = working ? modelElapsed(worker) : 0;
+        if (working)
+            ++m_metrics.modelsInFlight;
+    }
+
+    const QString error = m_pMetricsExporter->publish(m_metrics.exposition());
+    if (!error.isEmpty() && !m_bMetricsErrorShown)
+    {
+        m_bMetricsErrorShown = true;
+        appendLog(ui->debugTextBrowser, "<p><span style=\"color:red;\">" % tr("Could not write metrics: ") % error % "</span></p><br>");
+    }
+}
+
+void MainWindow::addBusyTime(const CleanWorker *worker)
+{
+    m_pPrefetcher->noteModelTime(modelElapsed(worker));
+    if (m_metrics.slotBusyMs.count() <= worker->slot)
+        m_metrics.slotBusyMs.resize(worker->slot + 1);
+    m_metrics.slotBusyMs[worker->slot] += modelElapsed(worker);
+    if (worker->task.stage == CleanTask::Decompile)
+        m_metrics.decompileBusyMs += modelElapsed(worker);
     else
-        args<<"last_dirs.pl";
-    m_pCleanProcess->start(m_sBinaryPath,args,QIODevice::ReadWrite);
-    ui->cleanButton->setDisabled(true);
-    if (m_pCleanProcess->waitForStarted())
-    {
-        ui->decompileCheck->setEnabled(false);
-        m_nMdlsCleaned = 0;
-        m_nMdlsFailed = 0;
-        ui->mdlsCleanedLabel->setText("Files Cleaned: 0");
-        ui->mdlsFailedLabel->setText("Failures: 0");
-        m_bCleanRunning = true;
-        ui->cleanButton->setDisabled(false);
-        ui->cleanButton->setText(tr("Abort"));
-        ui->cleanButton->setIcon(m_iconAbortButton);
-        m_pCleanProcess->moveToThread(QCoreApplication::instance()->thread());
+        m_metrics.cleanBusyMs += modelElapsed(worker);
+}
+
+qint64 MainWindow::modelElapsed(const CleanWorker *worker) const
+{
+    return worker->timer.elapsed() - worker->pausedMs;
+}
+
+void MainWindow::onLoadSampleTimer()
+{
+    const int maxWorkers = m_nDecompileWorkers + m_nCleanWorkers;
+    const LoadSample load = m_loadMonitor.sample();
+    if (!ui->adaptiveWorkersCheck->isChecked() || !load.valid)
+    {
+        m_nWorkerBudget = maxWorkers;
     }
     else
     {
-        QString errorMsg = "<p><span style=\"color:red;\">Failed to run clean! Does the " % m_sBinaryName % " executable exist in the working directory or your PATH?</span></p><br>" % m_sBinaryPath;
-        ui->debugTextBrowser->insertHtml(tr(errorMsg.toStdString().c_str()));
-        auto sb = ui->debugTextBrowser->verticalScrollBar();
-        sb->setValue(sb->maximum());
-        ui->cleanButton->setDisabled(false);
+        qint64 workersRssKb = 0;
+        for (const CleanWorker *worker : qAsConst(m_workers))
+        {
+            const qint64 rssKb = LoadMonitor::residentKb(worker->process->processId());
+            m_nPeakWorkerRssKb = qMax(m_nPeakWorkerRssKb, rssKb);
+            workersRssKb += rssKb;
+        }
+        // Plan with the hungriest worker seen so far, the next model may be as big
+        const qint64 perWorkerKb = qMax<qint64>(m_nPeakWorkerRssKb, 64 * 1024);
+        const qint64 ceilingKb = ui->memoryCeilingSpin->value() ? qint64(ui->memoryCeilingSpin->value()) * 1024 : load.memTotalKb / 2;
+        const qint64 reserveKb = load.memTotalKb / 10;
+        const int running = m_workers.count();
+        const int memoryBudget = int(qMin(ceilingKb / perWorkerKb, running + (load.memAvailableKb - reserveKb) / perWorkerKb));
+
+        int budget = m_nWorkerBudget;
+        if (load.memAvailableKb < reserveKb || workersRssKb > ceilingKb)
+            budget = running - 1;
+        else if (load.cpuBusy > 0.97 || load.ioPressure > 40.0)
+            budget = qMin(budget, running);
+        else if (load.cpuBusy < 0.85 && load.ioPressure < 20.0 && running >= budget)
+            budget = budget + 1;
+        m_nWorkerBudget = qBound(1, qMin(budget, memoryBudget), maxWorkers);
     }
+    ui->workersLabel->setText(tr("Workers: %1/%2").arg(m_workers.count()).arg(m_nWorkerBudget));
+    settleJobs();
 }
 
-void MainWindow::onCleanFinished(int, QProcess::ExitStatus)
+CleanTask MainWindow::remainingTask(CleanJob *job, const CleanWorker *worker, bool withCurrent)
 {
-    ui->debugTextBrowser->append(m_pCleanProcess->readAllStandardError());
-    m_bCleanRunning = false;
-    if (!ui->decompileCheck->isChecked())
-        ui->cleanButton->setText(tr("Clean"));
-    else
-        ui->cleanButton->setText(tr("Decompile"));
-    ui->decompileCheck->setEnabled(true);
-    ui->cleanButton->setIcon(m_iconCleanButton);
-    m_pCleanStatus->setText(tr("Idle"));
-    m_pStatusProgress->setVisible(false);
-    if(m_bUpdateFilesAfterClean)
+    CleanTask rest = worker->task;
+    rest.stagedFiles.clear();
+    rest.stagedBytes = 0;
+    rest.archiveEntries.clear();
+    auto pending = [worker, withCurrent](const QString& fileName) {
+        const QString key = worker->task.relDir.isEmpty() ? fileName : worker->task.relDir % "/" % fileName;
+        return (withCurrent || key != worker->currentModel) && !worker->doneModels.contains(key);
+    };
+    for (const QString &fileName : worker->task.stagedFiles)
     {
-        MainWindow::updateFileListing();
-        m_bUpdateFilesAfterClean = false;
+        if (pending(fileName))
+            rest.stagedFiles.append(fileName);
     }
+    for (int index : worker->task.archiveEntries)
+    {
+        if (job->inArchive && pending(job->inArchive->resourceFileName(index)))
+            rest.archiveEntries.append(index);
+    }
+    // Fresh folders, the old ones are still in use or about to be removed
+    const int serial = ++job->taskSerial;
+    rest.inDir = rest.stagedFiles.isEmpty() ? job->runDir->filePath(QString("retry_%1").arg(serial)) : selectionFolder(job, QString("retry_%1").arg(serial));
+    if (!rest.cleanOutDir.isEmpty())
+        rest.outDir = job->runDir->filePath(QString("decompiled_retry_%1").arg(serial));
+    return rest;
+}
+
+void MainWindow::abortRun()
+{
+    for (CleanJob *job : qAsConst(m_jobs))
+        abortJob(job);
+}
+
+void MainWindow::reportStartFailure()
+{
+    QString errorMsg = "<p><span style=\"color:red;\">Failed to run clean! Does the " % m_sBinaryName % " executable exist in the working directory or your PATH?</span></p><br>" % m_sBinaryPath;
+    appendLog(ui->debugTextBrowser, tr(errorMsg.toStdString().c_str()));
+    auto sb = ui->debugTextBrowser->verticalScrollBar();
+    sb->setValue(sb->maximum());
 }
 
-int MainWindow::findModelRow(const QString& mdlFile)
+CleanWorker *MainWindow::workerFor(QObject *process) const
 {
-    int rows = ui->filesTable->rowCount();
-    int foundRow = 0; // fall back to first row if we can't find it for some reason
-    for (int i = 0; i < rows; ++i)
+    for (CleanWorker *worker : m_workers)
     {
-        if (ui->filesTable->item(i, 0)->text() == mdlFile)
+        if (worker->process == process)
+            return worker;
+    }
+    return nullptr;
+}
+
+void MainWindow::onCleanFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    CleanWorker *worker = workerFor(sender());
+    if (!worker)
+        return;
+    CleanJob *job = findJob(worker->task.jobId);
+    drainWorker(worker, QProcess::StandardOutput);
+    drainWorker(worker, QProcess::StandardError);
+    if (!worker->partialLine.isEmpty())
+        parseWorkerLine(worker, QString::fromUtf8(worker->partialLine).trimmed());
+    if (!worker->partialErrorLine.isEmpty())
+        parseWorkerLine(worker, QString::fromUtf8(worker->partialErrorLine).trimmed(), true);
+    const QString errorOutput = worker->modelErrors;
+
+    // A worker that died in the middle of a model takes only that model
+    // down, the rest of its chunk goes back to the front of the queue
+    CleanTask retry;
+    const bool died = exitStatus == QProcess::CrashExit || exitCode != 0 || (worker->persistent && !worker->idle);
+    // A CLI without --serve exits before answering its first model, the
+    // chunk then runs again with one process per chunk
+    const bool unsupported = worker->persistent && !worker->idle && !worker->served &&
+        exitStatus == QProcess::NormalExit && job && !job->aborted;
+    // A remote agent that went away takes none of the models down, all the
+    // ones it has not reported run again elsewhere
+    const bool agentLost = !worker->agent.isEmpty() && exitStatus == QProcess::NormalExit &&
+        exitCode == RemoteProtocol::LostExitCode && job && !job->aborted;
+    bool requeue = false; // the chunk goes back to the queue as it is
+    if (unsupported || agentLost)
+    {
+        if (agentLost)
+            markAgentLost(worker->agent);
+        else if (m_bPersistentWorkers)
         {
-            foundRow = i;
-            break;
+            m_bPersistentWorkers = false;
+            appendLog(ui->debugTextBrowser, "<p><span style=\"color:red;\">" % m_sBinaryName % tr(" does not support persistent workers, starting one process per chunk instead.") % "</span></p><br>");
+        }
+        // A CLI that ran the chunk from its options file anyway has written
+        // and committed some models, those are not cleaned twice
+        if (worker->doneModels.isEmpty())
+        {
+            requeue = true;
+            retry = worker->task;
+        }
+        else if (worker->task.stagedFiles.isEmpty() && worker->task.archiveEntries.isEmpty() &&
+                 job->runDir && worker->task.inDir.startsWith(job->runDir->path()))
+        {
+            // Hand-offs read the decompiled models in place, the ones done
+            // already are dropped from the folder
+            for (const QString &model : qAsConst(worker->doneModels))
+                QFile::remove(worker->task.inDir % "/" % QFileInfo(model).fileName());
+            requeue = true;
+            retry = worker->task;
+        }
+        else
+        {
+            // A flat run read the input folder itself, the rest of it goes
+            // on as a selection
+            if (worker->task.stagedFiles.isEmpty() && worker->task.archiveEntries.isEmpty())
+            {
+                worker->task.sourceDir = worker->task.inDir;
+                worker->task.stagedFiles = taskModels(job, worker->task);
+            }
+            retry = remainingTask(job, worker, true);
         }
     }
-    return foundRow;
+    else if (died && job && !job->aborted && !worker->currentModel.isEmpty() && !worker->doneModels.contains(worker->currentModel))
+    {
+        const bool limited = !m_processLimits.isEmpty() &&
+            (exitStatus == QProcess::CrashExit || errorOutput.contains(QRegExp("resource|memory|stack", Qt::CaseInsensitive)));
+        job->failed++;
+        ++m_metrics.modelsFailed;
+        addBusyTime(worker);
+        updateJobCounters(job);
+        auto *twiLimit = new QTableWidgetItem();
+        twiLimit->setText(limited ? tr("Resource limit") : tr("Failed"));
+        twiLimit->setIcon(m_iconCleanError);
+        twiLimit->setData(ResultsProxyModel::FailedRole, true);
+        twiLimit->setToolTip(limited ? tr("The worker exceeded its memory or CPU time limit") : tr("The worker stopped unexpectedly"));
+        job->table->setItem(findModelRow(job, worker->currentModel), 2, twiLimit);
+        auto *twiCleanTimer = new QTableWidgetItem();
+        twiCleanTimer->setText(QTime(0,0).addMSecs(modelElapsed(worker)).toString("mm:ss.zzz"));
+        twiCleanTimer->setTextAlignment(Qt::AlignCenter);
+        job->table->setItem(findModelRow(job, worker->currentModel), 4, twiCleanTimer);
+        retry = remainingTask(job, worker);
+    }
+    m_workers.removeOne(worker);
+    worker->process->deleteLater();
+    CleanTask task = worker->task;
+    const bool idle = worker->idle;
+    delete worker;
+
+    if (requeue)
+    {
+        // Staged copies are made afresh when the chunk starts again
+        const QString prefetchedFor = m_pPrefetcher->release(task.inDir);
+        if (!prefetchedFor.isEmpty())
+            task.inDir = prefetchedFor;
+        else if (!task.stagedFiles.isEmpty() || !task.archiveEntries.isEmpty())
+            QDir(task.inDir).removeRecursively();
+        if (task.stage == CleanTask::Decompile)
+            job->decompileQueue.prepend(task);
+        else
+            job->cleanQueue.prepend(task);
+    }
+    else if (job && !idle)
+    {
+        completeTask(job, task);
+    }
+    if (job && !requeue && (!retry.stagedFiles.isEmpty() || !retry.archiveEntries.isEmpty()))
+    {
+        if (retry.stage == CleanTask::Decompile)
+            job->decompileQueue.prepend(retry);
+        else
+            job->cleanQueue.prepend(retry);
+    }
+    settleJobs();
+}
+
+// The chunk is through, its scratch input goes and decompiled models move
+// on to the clean stage
+void MainWindow::completeTask(CleanJob *job, const CleanTask& task)
+{
+    const bool scratch = (job->runDir && task.inDir.startsWith(job->runDir->path())) ||
+                         (job->selectionDir && task.inDir.startsWith(job->selectionDir->path()));
+    if (m_pPrefetcher->release(task.inDir).isEmpty() && scratch)
+        QDir(task.inDir).removeRecursively();
+    if (!job->aborted && !task.cleanOutDir.isEmpty())
+    {
+        CleanTask handoff;
+        handoff.jobId = task.jobId;
+        handoff.relDir = task.relDir;
+        handoff.inDir = task.outDir;
+        handoff.outDir = task.cleanOutDir;
+        handoff.pattern = task.pattern;
+        handoff.generatedOptions = true;
+        job->handoffQueue.append(handoff);
+    }
+}
+
+void MainWindow::finishRun()
+{
+    m_bRunActive = false;
+    m_pLoadTimer->stop();
+    ui->workersLabel->setText(tr("Workers:"));
+    m_bPaused = false;
+    {
+        QSignalBlocker blockPause(ui->actionPause);
+        ui->actionPause->setChecked(false);
+    }
+    ui->actionPause->setText(tr("Pause"));
+    ui->actionPause->setEnabled(false);
+    m_pCleanStatus->setText(tr("Idle"));
+    m_pStatusProgress->setVisible(false);
+}
+
+QString MainWindow::modelKey(const CleanWorker *worker, const QString& reportedPath) const
+{
+    QString fileName = QFileInfo(reportedPath).fileName();
+    return worker->task.relDir.isEmpty() ? fileName : worker->task.relDir % "/" % fileName;
+}
+
+int MainWindow::findModelRow(const CleanJob *job, const QString& mdlFile)
+{
+    // fall back to first row if we can't find it for some reason
+    auto *item = job->items.value(mdlFile);
+    return item ? item->row() : 0;
 }
@@ -0,0 +1,892 @@
+﻿#include "mainwindow.h"
+#include "ui_mainwindow.h"
+#include "fixcatalog.h"
+#include "resultsbrowser.h"
+#include <QCoreApplication>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QFormLayout>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QMessageBox>
+#include <QRegularExpression>
+#include <QScrollBar>
+#include <QSettings>
+#include <QSpinBox>
+#include <QSplitter>
+#include <QStandardPaths>
+#include <QStringBuilder>
+#include <QTableWidget>
+#include <QTextBrowser>
+#include <QTime>
+
+namespace
+{
+QString stateText(CleanJob::State state)
+{
+    switch (state)
+    {
+    case CleanJob::Queued:
+        return MainWindow::tr("Queued");
+    case CleanJob::Listing:
+        return MainWindow::tr("Listing");
+    case CleanJob::Running:
+        return MainWindow::tr("Running");
+    case CleanJob::Finished:
+        return MainWindow::tr("Finished");
+    case CleanJob::Failed:
+        return MainWindow::tr("Failed");
+    case CleanJob::Aborted:
+        return MainWindow::tr("Aborted");
+    }
+    return QString();
+}
+
+QString severityText(LogIndex::Severity severity)
+{
+    switch (severity)
+    {
+    case LogIndex::Error:
+        return MainWindow::tr("Error");
+    case LogIndex::Written:
+        return MainWindow::tr("Written");
+    case LogIndex::Read:
+        return MainWindow::tr("Read");
+    default:
+        return MainWindow::tr("Other");
+    }
+}
+}
+
+
+CleanJob *MainWindow::newJob()
+{
+    auto *job = new CleanJob;
+    job->id = ++m_nJobSerial;
+    job->inDir = m_sInDir;
+    job->outDir = m_sOutDir;
+    job->pattern = ui->filePattern->text();
+    job->name = QFileInfo(m_sInDir).fileName();
+    job->recursive = ui->recursiveCheck->isChecked();
+    job->decompileOnly = ui->decompileCheck->isChecked();
+    job->dedupe = ui->dedupeCheck->isChecked();
+    QFile lastDirs(m_sLastDirsPath);
+    if (lastDirs.open(QIODevice::ReadOnly | QIODevice::Text))
+        job->options = lastDirs.readAll();
+    return job;
+}
+
+bool MainWindow::editJob(CleanJob *job)
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("Queue Job"));
+    auto *form = new QFormLayout(&dialog);
+    auto *nameEdit = new QLineEdit(job->name, &dialog);
+    auto *inDirEdit = new QLineEdit(job->inDir, &dialog);
+    inDirEdit->setCompleter(m_pDirCompleter);
+    inDirEdit->setWhatsThis(tr("Folder, or hak, erf or mod file, holding the models of this job."));
+    auto *outDirEdit = new QLineEdit(job->outDir, &dialog);
+    outDirEdit->setCompleter(m_pDirCompleter);
+    outDirEdit->setWhatsThis(tr("Folder, or hak, erf or mod file, the processed models are written to."));
+    auto *patternEdit = new QLineEdit(job->pattern, &dialog);
+    auto *prioritySpin = new QSpinBox(&dialog);
+    prioritySpin->setRange(-99, 99);
+    prioritySpin->setValue(job->priority);
+    prioritySpin->setWhatsThis(tr("Jobs of the highest priority share the workers. Jobs with a lower priority start once those have handed out all their models."));
+    form->addRow(tr("Name:"), nameEdit);
+    form->addRow(tr("Input:"), inDirEdit);
+    form->addRow(tr("Output:"), outDirEdit);
+    form->addRow(tr("File pattern:"), patternEdit);
+    form->addRow(tr("Priority:"), prioritySpin);
+    auto *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+    if (dialog.exec() != QDialog::Accepted)
+        return false;
+    if (inDirEdit->text().trimmed().isEmpty() || outDirEdit->text().trimmed().isEmpty())
+    {
+        QMessageBox::information(this, tr("Queue Job"), tr("A job needs an input and an output."));
+        return false;
+    }
+    job->inDir = inDirEdit->text().trimmed();
+    job->outDir = outDirEdit->text().trimmed();
+    job->pattern = patternEdit->text().trimmed().isEmpty() ? QString("*.mdl") : patternEdit->text().trimmed();
+    job->name = nameEdit->text().trimmed().isEmpty() ? QFileInfo(job->inDir).fileName() : nameEdit->text().trimmed();
+    job->priority = prioritySpin->value();
+    return true;
+}
+
+void MainWindow::addJob(CleanJob *job)
+{
+    if (!job->table)
+    {
+        // Queued jobs keep their results next to the queue
+        auto *splitter = new QSplitter(Qt::Vertical);
+        splitter->setChildrenCollapsible(false);
+        job->table = new QTableWidget(splitter);
+        ResultsBrowser *browser = setupResultsTable(job->table);
+        job->log = new QTextBrowser(splitter);
+        job->page = splitter;
+        const int jobId = job->id;
+        connect(browser, &ResultsBrowser::rowDoubleClicked, this, [this, jobId](int row) {
+            CleanJob *shown = findJob(jobId);
+            if (shown && shown->table->item(row, 0))
+                showModelLog(shown, shown->table->item(row, 0)->text());
+        });
+        ui->jobResultsStack->addWidget(splitter);
+    }
+    m_jobs.append(job);
+    const int row = ui->jobsTable->rowCount();
+    ui->jobsTable->insertRow(row);
+    for (int column : {0, 1, 2, 4, 5})
+        ui->jobsTable->setItem(row, column, new QTableWidgetItem());
+    auto *prioritySpin = new QSpinBox();
+    prioritySpin->setRange(-99, 99);
+    prioritySpin->setValue(job->priority);
+    prioritySpin->setFrame(false);
+    const int jobId = job->id;
+    connect(prioritySpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [this, jobId](int priority) {
+        if (CleanJob *changed = findJob(jobId))
+        {
+            changed->priority = priority;
+            settleJobs();
+        }
+    });
+    ui->jobsTable->setCellWidget(row, 3, prioritySpin);
+    updateJobRow(job);
+    ui->jobsTable->setCurrentCell(row, 0);
+}
+
+void MainWindow::updateJobRow(CleanJob *job)
+{
+    const int row = m_jobs.indexOf(job);
+    if (row < 0)
+        return;
+    ui->jobsTable->item(row, 0)->setText(job->name);
+    ui->jobsTable->item(row, 1)->setText(job->inDir);
+    ui->jobsTable->item(row, 2)->setText(job->outDir);
+    ui->jobsTable->item(row, 4)->setText(stateText(job->state));
+    if (job->state != CleanJob::Queued && job->state != CleanJob::Listing)
+        ui->jobsTable->item(row, 5)->setText(tr("%1/%2, %3 failed").arg(job->cleaned).arg(job->entries.count()).arg(job->failed));
+}
+
+void MainWindow::updateJobCounters(CleanJob *job)
+{
+    if (job == m_pViewJob)
+    {
+        const QString actionVerbPast = job->decompileOnly ? tr("Decompiled") : tr("Cleaned");
+        ui->mdlsCleanedLabel->setText("Files " % actionVerbPast % ": " % QString::number(job->cleaned));
+        ui->mdlsFailedLabel->setText("Failures: " % QString::number(job->failed));
+    }
+    updateJobRow(job);
+}
+
+// Always at the end, wherever the reader left the cursor, so recorded
+// ranges stay valid. Follows new lines unless scrolled away from the end.
+void MainWindow::appendLog(QTextBrowser *log, const QString& html)
+{
+    auto sb = log->verticalScrollBar();
+    const bool following = sb->value() == sb->maximum();
+    QTextCursor cursor(log->document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertHtml(html);
+    if (following)
+        sb->setValue(sb->maximum());
+}
+
+void MainWindow::appendJobLog(const CleanJob *job, const QString& html)
+{
+    appendLog(job->log, html);
+}
+
+void MainWindow::appendModelLog(CleanJob *job, const QString& model, const QString& html, LogIndex::Severity severity, const QString& text)
+{
+    m_logIndex.addLine(job->id, model, severity, text);
+    const int start = job->log->document()->characterCount() - 1;
+    appendJobLog(job, html);
+    if (model.isEmpty())
+        return;
+    const int end = job->log->document()->characterCount() - 1;
+    QVector<QPair<int, int>> &ranges = job->logSlices[model];
+    if (!ranges.isEmpty() && ranges.last().second == start)
+        ranges.last().second = end;
+    else
+        ranges.append(qMakePair(start, end));
+}
+
+// Marks every line of the model and scrolls to the first one, the cost
+// depends on the model's lines only, not on the size of the log
+void MainWindow::showModelLog(const CleanJob *job, const QString& model)
+{
+    const QVector<QPair<int, int>> ranges = job->logSlices.value(model);
+    if (ranges.isEmpty())
+        return;
+    QList<QTextEdit::ExtraSelection> selections;
+    for (const auto &range : ranges)
+    {
+        QTextEdit::ExtraSelection selection;
+        selection.cursor = QTextCursor(job->log->document());
+        selection.cursor.setPosition(range.first);
+        selection.cursor.setPosition(range.second, QTextCursor::KeepAnchor);
+        selection.format.setBackground(QColor(255, 240, 160));
+        selections.append(selection);
+    }
+    job->log->setExtraSelections(selections);
+    QTextCursor first(job->log->document());
+    first.setPosition(ranges.first().second);
+    job->log->setTextCursor(first);
+    first.setPosition(ranges.first().first);
+    job->log->setTextCursor(first);
+}
+
+void MainWindow::on_logSearchEdit_textChanged(const QString&)
+{
+    runLogSearch();
+}
+
+void MainWindow::on_logSeverityCombo_currentIndexChanged(int)
+{
+    runLogSearch();
+}
+
+void MainWindow::runLogSearch()
+{
+    // In the order of logSeverityCombo
+    static const int severities[] = {LogIndex::AnySeverity, LogIndex::Error, LogIndex::Written, LogIndex::Read, LogIndex::Other};
+    const int maxMatches = 2000;
+    ui->logSearchTable->setRowCount(0);
+    const int severity = severities[qBound(0, ui->logSeverityCombo->currentIndex(), 4)];
+    if (ui->logSearchEdit->text().trimmed().isEmpty() && severity == LogIndex::AnySeverity)
+    {
+        ui->logSearchLabel->clear();
+        return;
+    }
+    QElapsedTimer searchTimer;
+    searchTimer.start();
+    const QVector<int> matches = m_logIndex.search(ui->logSearchEdit->text(), severity, maxMatches);
+    const qint64 searchMs = searchTimer.elapsed();
+    ui->logSearchTable->setRowCount(matches.count());
+    for (int row = 0; row < matches.count(); ++row)
+    {
+        const LogIndex::Line &line = m_logIndex.line(matches.at(row));
+        const CleanJob *job = findJob(line.jobId);
+        auto *jobItem = new QTableWidgetItem(job ? job->name : QString());
+        jobItem->setData(Qt::UserRole, matches.at(row));
+        ui->logSearchTable->setItem(row, 0, jobItem);
+        ui->logSearchTable->setItem(row, 1, new QTableWidgetItem(line.model));
+        ui->logSearchTable->setItem(row, 2, new QTableWidgetItem(severityText(line.severity)));
+        ui->logSearchTable->setItem(row, 3, new QTableWidgetItem(line.text));
+    }
+    if (matches.count() >= maxMatches)
+        ui->logSearchLabel->setText(tr("First %1 matches, %2 ms").arg(matches.count()).arg(searchMs));
+    else
+        ui->logSearchLabel->setText(tr("%1 matches, %2 ms").arg(matches.count()).arg(searchMs));
+}
+
+void MainWindow::on_logSearchTable_cellDoubleClicked(int row, int)
+{
+    const QTableWidgetItem *matchItem = ui->logSearchTable->item(row, 0);
+    if (!matchItem)
+        return;
+    const LogIndex::Line &line = m_logIndex.line(matchItem->data(Qt::UserRole).toInt());
+    CleanJob *job = findJob(line.jobId);
+    if (!job || line.model.isEmpty())
+        return;
+    revealModel(job, line.model);
+}
+
+// Selects the job and the model's row and marks the model's lines in the log
+void MainWindow::revealModel(CleanJob *job, const QString& model)
+{
+    ui->jobsTable->setCurrentCell(m_jobs.indexOf(job), 0);
+    // filesTable is refilled by every listing, its current rows are the ones to go by
+    const QHash<QString, QTableWidgetItem*> &items = job->table == ui->filesTable ? m_modelItems : job->items;
+    if (QTableWidgetItem *modelItem = items.value(model))
+    {
+        job->table->setCurrentItem(modelItem);
+        job->table->scrollToItem(modelItem);
+    }
+    showModelLog(job, model);
+}
+
+// The fix lines of a model only count when they add up to the CLI's own
+// count, otherwise its breakdown is left out rather than guessed
+bool MainWindow::settleFixes(CleanJob *job, CleanWorker *worker, int reported)
+{
+    QVector<quint16> counts;
+    counts.swap(worker->modelFixes);
+    int sum = 0;
+    for (quint16 count : qAsConst(counts))
+        sum += count;
+    if (sum != reported)
+    {
+        job->unmatchedFixes.insert(worker->currentModel);
+        return false;
+    }
+    if (!sum)
+        return true;
+    job->modelFixes.insert(worker->currentModel, counts);
+    if (job->fixTotals.isEmpty())
+        job->fixTotals.resize(FixCatalog::categoryCount());
+    for (int category = 0; category < counts.count(); ++category)
+        job->fixTotals[category] += counts.at(category);
+    return true;
+}
+
+void MainWindow::onFixBreakdownTriggered()
+{
+    // The job selected in the queue, otherwise the latest one
+    const int selected = ui->jobsTable->currentRow();
+    CleanJob *job = selected >= 0 && selected < m_jobs.count() ? m_jobs.at(selected) : (m_jobs.isEmpty() ? nullptr : m_jobs.last());
+    if (!job || job->fixTotals.isEmpty())
+    {
+        QString message = tr("No fixes have been reported yet.");
+        if (job && !job->unmatchedFixes.isEmpty())
+            message = tr("The fix lines of %1 models did not add up to the fixes the CLI counted, there is no breakdown for them.").arg(job->unmatchedFixes.count());
+        QMessageBox::information(this, tr("Fix Breakdown"), message);
+        return;
+    }
+    const int jobId = job->id;
+    QVector<int> modelCounts(FixCatalog::categoryCount());
+    for (auto it = job->modelFixes.constBegin(); it != job->modelFixes.constEnd(); ++it)
+    {
+        for (int category = 0; category < modelCounts.count(); ++category)
+        {
+            if (it.value().at(category))
+                ++modelCounts[category];
+        }
+    }
+
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("Fix Breakdown of %1").arg(job->name));
+    auto *outerLayout = new QVBoxLayout(&dialog);
+    auto *layout = new QHBoxLayout();
+    outerLayout->addLayout(layout);
+    if (!job->unmatchedFixes.isEmpty())
+        outerLayout->addWidget(new QLabel(tr("%1 models are left out, their fix lines did not add up to the fixes the CLI counted.").arg(job->unmatchedFixes.count()), &dialog));
+    auto *categoryTable = new QTableWidget(0, 3, &dialog);
+    categoryTable->setHorizontalHeaderLabels({tr("Category"), tr("Fixes"), tr("Models")});
+    auto *modelTable = new QTableWidget(0, 2, &dialog);
+    modelTable->setHorizontalHeaderLabels({tr("Model"), tr("Fixes")});
+    for (QTableWidget *table : {categoryTable, modelTable})
+    {
+        table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        table->setSelectionBehavior(QAbstractItemView::SelectRows);
+        table->setSelectionMode(QAbstractItemView::SingleSelection);
+        table->verticalHeader()->setVisible(false);
+        table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+        layout->addWidget(table);
+    }
+    for (int category = 0; category < job->fixTotals.count(); ++category)
+    {
+        if (!job->fixTotals.at(category))
+            continue;
+        const int row = categoryTable->rowCount();
+        categoryTable->insertRow(row);
+        auto *nameItem = new QTableWidgetItem(tr(FixCatalog::categoryName(category).toUtf8().constData()));
+        nameItem->setData(Qt::UserRole, category);
+        auto *fixesItem = new QTableWidgetItem();
+        fixesItem->setData(Qt::DisplayRole, job->fixTotals.at(category));
+        auto *modelsItem = new QTableWidgetItem();
+        modelsItem->setData(Qt::DisplayRole, modelCounts.at(category));
+        categoryTable->setItem(row, 0, nameItem);
+        categoryTable->setItem(row, 1, fixesItem);
+        categoryTable->setItem(row, 2, modelsItem);
+    }
+    categoryTable->setSortingEnabled(true);
+    categoryTable->sortByColumn(1, Qt::DescendingOrder);
+
+    // Drill down from a category to the models that needed it
+    connect(categoryTable, &QTableWidget::currentCellChanged, &dialog, [this, jobId, categoryTable, modelTable](int row) {
+        const CleanJob *shown = findJob(jobId);
+        modelTable->setSortingEnabled(false);
+        modelTable->setRowCount(0);
+        if (!shown || !categoryTable->item(row, 0))
+            return;
+        const int category = categoryTable->item(row, 0)->data(Qt::UserRole).toInt();
+        for (auto it = shown->modelFixes.constBegin(); it != shown->modelFixes.constEnd(); ++it)
+        {
+            if (!it.value().at(category))
+                continue;
+            const int modelRow = modelTable->rowCount();
+            modelTable->insertRow(modelRow);
+            modelTable->setItem(modelRow, 0, new QTableWidgetItem(it.key()));
+            auto *countItem = new QTableWidgetItem();
+            countItem->setData(Qt::DisplayRole, int(it.value().at(category)));
+            modelTable->setItem(modelRow, 1, countItem);
+        }
+        modelTable->setSortingEnabled(true);
+        modelTable->sortByColumn(1, Qt::DescendingOrder);
+    });
+    connect(modelTable, &QTableWidget::cellDoubleClicked, &dialog, [this, jobId, modelTable](int row) {
+        CleanJob *shown = findJob(jobId);
+        if (shown && modelTable->item(row, 0))
+            revealModel(shown, modelTable->item(row, 0)->text());
+    });
+    categoryTable->setCurrentCell(0, 0);
+    dialog.resize(720, 420);
+    dialog.exec();
+}
+
+CleanJob *MainWindow::findJob(int id) const
+{
+    for (CleanJob *job : m_jobs)
+    {
+        if (job->id == id)
+            return job;
+    }
+    return nullptr;
+}
+
+// Value of a :-asserta(key('value')). line as written by withUserOption()
+QString MainWindow::coreOption(const QString& optionsText, const QString& key)
+{
+    QString str = "^:-asserta\\(" % key % R"(\('?(.*?)'?\)\)\.$)";
+    QRegularExpression re(str, QRegularExpression::MultilineOption);
+    return re.match(optionsText).captured(1);
+}
+
+// Jobs of the highest priority run side by side, a lower priority job only
+// starts once the jobs above it have handed all their models to the workers
+void MainWindow::activateJobs()
+{
+    for (;;)
+    {
+        CleanJob *next = nullptr;
+        int activePriority = 0;
+        bool backlog = false;
+        for (CleanJob *job : qAsConst(m_jobs))
+        {
+            if (job->isActive() && (job->state == CleanJob::Listing || job->hasQueuedTasks()))
+            {
+                activePriority = backlog ? qMax(activePriority, job->priority) : job->priority;
+                backlog = true;
+            }
+            else if (job->state == CleanJob::Queued && (!next || job->priority > next->priority))
+            {
+                next = job;
+            }
+        }
+        if (!next || (backlog && next->priority < activePriority))
+            return;
+        listJob(next);
+    }
+}
+
+void MainWindow::listJob(CleanJob *job)
+{
+    beginRun();
+    job->state = CleanJob::Listing;
+    updateJobRow(job);
+    job->log->clear();
+    appendJobLog(job, tr("Listing ") % job->inDir % "<br>");
+    const int jobId = job->id;
+    if (job->watched)
+    {
+        // Watch mode hands over the models that landed, there is nothing to list
+        onJobListingReady(jobId);
+        return;
+    }
+    if (ErfArchive::isArchivePath(job->inDir))
+    {
+        job->inArchive = new ErfArchive();
+        if (!job->inArchive->open(QDir(QDir::currentPath()).absoluteFilePath(job->inDir)))
+        {
+            QString errorMsg = "<p><span style=\"color:red;\">" % tr("Could not read archive ") % job->inDir % ": " % job->inArchive->errorString() % "</span></p><br>";
+            appendJobLog(job, errorMsg);
+            job->state = CleanJob::Failed;
+            finishJob(job);
+            return;
+        }
+        job->entries = archiveModels(job->inArchive, job->pattern);
+        onJobListingReady(jobId);
+        return;
+    }
+    job->walker = new DirWalker(this);
+    connect(job->walker, &DirWalker::finished, this, [this, jobId]() {
+        onJobListingReady(jobId);
+        settleJobs();
+    });
+    job->walker->start(job->inDir, QStringList(job->pattern), job->recursive);
+}
+
+void MainWindow::onJobListingReady(int jobId)
+{
+    CleanJob *job = findJob(jobId);
+    if (!job || job->state != CleanJob::Listing)
+        return;
+    if (job->walker)
+    {
+        job->entries = job->walker->results();
+        job->walker->deleteLater();
+        job->walker = nullptr;
+    }
+    fillResultsTable(job->table, job->entries, job->items);
+    appendJobLog(job, tr("Files detected: ") % QString::number(job->entries.count()) % "<br>");
+    if (job->dedupe && job->entries.count() > 1)
+    {
+        job->scanner = new DuplicateScanner(this);
+        connect(job->scanner, &DuplicateScanner::finished, this, [this, jobId]() {
+            onJobDuplicatesReady(jobId);
+            settleJobs();
+        }, Qt::QueuedConnection);
+        job->scanner->start(job->entries, job->inDir, job->inArchive);
+        return;
+    }
+    startJob(job);
+}
+
+void MainWindow::onJobDuplicatesReady(int jobId)
+{
+    CleanJob *job = findJob(jobId);
+    if (!job || !job->scanner)
+        return;
+    DuplicateScanner *scanner = job->scanner;
+    job->scanner = nullptr;
+    scanner->deleteLater();
+    if (scanner->groups().count() == job->entries.count() && scanner->groupCount())
+    {
+        showDuplicateGroups(scanner, job->entries, job->table, job->items, job->duplicates, job->duplicateOf, true);
+        appendJobLog(job, QString::number(job->duplicateOf.count()) % tr(" duplicate models found in ") % QString::number(scanner->groupCount()) % tr(" groups, each group is cleaned once.<br>"));
+    }
+    startJob(job);
+}
+
+// False when the job ended right away, its log says why
+bool MainWindow::startJob(CleanJob *job)
+{
+    beginRun();
+    job->state = CleanJob::Running;
+    job->elapsed.start();
+    job->runDir = new QTemporaryDir(QDir::tempPath() % "/cleanmodels-qt-XXXXXX");
+    if (ErfArchive::isArchivePath(job->inDir) && !job->inArchive)
+    {
+        job->inArchive = new ErfArchive();
+        if (!job->inArchive->open(QDir(QDir::currentPath()).absoluteFilePath(job->inDir)))
+        {
+            QString errorMsg = "<p><span style=\"color:red;\">" % tr("Could not read archive ") % job->inDir % ": " % job->inArchive->errorString() % "</span></p><br>";
+            appendJobLog(job, errorMsg);
+            job->state = CleanJob::Failed;
+            finishJob(job);
+            return false;
+        }
+    }
+    if (!ErfArchive::isArchivePath(job->outDir))
+    {
+        // Models are written next to their destination and only moved into
+        // place once complete, an abort never leaves a truncated model behind
+        const QString outRoot = QDir(QDir::currentPath()).absoluteFilePath(job->outDir);
+        QDir().mkpath(outRoot);
+        job->stageDir = new QTemporaryDir(outRoot % "/.cleanmodels-staging-XXXXXX");
+        if (!job->stageDir->isValid())
+        {
+            QString errorMsg = "<p><span style=\"color:red;\">" % tr("Could not create a staging folder in ") % job->outDir % "</span></p><br>";
+            appendJobLog(job, errorMsg);
+            job->state = CleanJob::Failed;
+            finishJob(job);
+            return false;
+        }
+    }
+    if (!ErfArchive::isArchivePath(job->inDir))
+    {
+        // Selections hard link their models, which needs the input's file
+        // system. In a hidden folder of the input, which listings skip, else
+        // in the staging folder.
+        const QString inRoot = QDir(QDir::currentPath()).absoluteFilePath(job->inDir);
+        job->selectionDir = new QTemporaryDir(inRoot % "/.cleanmodels-selection-XXXXXX");
+        if (!job->selectionDir->isValid() && job->stageDir)
+        {
+            delete job->selectionDir;
+            job->selectionDir = new QTemporaryDir(job->stageDir->filePath(".selection-XXXXXX"));
+        }
+        if (!job->selectionDir->isValid())
+        {
+            delete job->selectionDir;
+            job->selectionDir = nullptr;
+        }
+    }
+    const QList<CleanTask> tasks = buildCleanTasks(job, job->entries);
+    for (const CleanTask &task : tasks)
+    {
+        if (task.stage == CleanTask::Decompile)
+            job->decompileQueue.append(task);
+        else
+            job->cleanQueue.append(task);
+    }
+    if (job->watched)
+    {
+        if (tasks.isEmpty())
+            warmWatchWorker(job);
+    }
+    else if (tasks.isEmpty())
+    {
+        appendJobLog(job, tr("No models matching the file pattern were found.<br>"));
+        finishJob(job);
+        return false;
+    }
+    if (!openOutputArchive(job))
+    {
+        QString errorMsg = "<p><span style=\"color:red;\">" % tr("Could not create archive ") % job->outDir % ": " % job->outArchive->errorString() % "</span></p><br>";
+        appendJobLog(job, errorMsg);
+        job->state = CleanJob::Failed;
+        finishJob(job);
+        return false;
+    }
+    updateJobRow(job);
+    return true;
+}
+
+void MainWindow::abortJob(CleanJob *job)
+{
+    if (job->state == CleanJob::Queued)
+    {
+        job->state = CleanJob::Aborted;
+        updateJobRow(job);
+        return;
+    }
+    if (!job->isActive())
+        return;
+    job->aborted = true;
+    if (job->state == CleanJob::Listing)
+    {
+        finishJob(job);
+        return;
+    }
+    job->cleanQueue.clear();
+    job->decompileQueue.clear();
+    job->handoffQueue.clear();
+    for (CleanWorker *worker : qAsConst(m_workers))
+    {
+        if (worker->task.jobId != job->id)
+            continue;
+        worker->process->kill();
+        if (worker->currentModel.isEmpty())
+            continue;
+        auto *twiCleanAborted = new QTableWidgetItem();
+        twiCleanAborted->setText(tr("Aborted"));
+        twiCleanAborted->setIcon(m_iconAbortButton);
+        twiCleanAborted->setToolTip(tr("Aborted"));
+        job->table->setItem(findModelRow(job, worker->currentModel), 2, twiCleanAborted);
+    }
+    updateJobRow(job);
+}
+
+// Only called once no worker and no commit of the job is left
+void MainWindow::finishJob(CleanJob *job)
+{
+    if (job->walker)
+    {
+        job->walker->cancel();
+        job->walker->deleteLater();
+        job->walker = nullptr;
+    }
+    if (job->scanner)
+    {
+        job->scanner->cancel();
+        job->scanner->deleteLater();
+        job->scanner = nullptr;
+    }
+    job->cleanQueue.clear();
+    job->decompileQueue.clear();
+    job->handoffQueue.clear();
+    if (job->isActive())
+        job->state = job->aborted ? CleanJob::Aborted : CleanJob::Finished;
+    finishOutputArchive(job);
+    m_pPrefetcher->dropJob(job->id);
+    delete job->stageDir;
+    job->stageDir = nullptr;
+    delete job->selectionDir;
+    job->selectionDir = nullptr;
+    delete job->runDir;
+    job->runDir = nullptr;
+    delete job->inArchive;
+    job->inArchive = nullptr;
+    if (job->elapsed.isValid())
+    {
+        QString summary = stateText(job->state) % tr(" after ") % QTime(0,0).addMSecs(job->elapsed.elapsed()).toString("hh:mm:ss") % ": " %
+                          QString::number(job->cleaned) % tr(" done, ") % QString::number(job->failed) % tr(" failed.");
+        appendJobLog(job, "<p><b>" % summary % "</b></p><br>");
+        // Fix lines worded in a way FixCatalog does not know show up here
+        if (!job->unmatchedFixes.isEmpty())
+            appendJobLog(job, "<span style=\"color:darkorange;\">" % tr("The fix breakdown covers %1 models with fixes, %2 more are left out because their fix lines did not add up to the CLI's count.")
+                                  .arg(job->modelFixes.count()).arg(job->unmatchedFixes.count()) % "</span><br>");
+    }
+    updateJobRow(job);
+    if (job != m_pViewJob)
+        return;
+
+    // filesTable belongs to the listing again
+    m_pViewJob = nullptr;
+    job->items.clear();
+    m_bCleanRunning = false;
+    if (!ui->decompileCheck->isChecked())
+        ui->cleanButton->setText(tr("Clean"));
+    else
+        ui->cleanButton->setText(tr("Decompile"));
+    ui->decompileCheck->setEnabled(true);
+    ui->dedupeCheck->setEnabled(true);
+    ui->cleanButton->setIcon(m_iconCleanButton);
+    if(m_bUpdateFilesAfterClean)
+    {
+        MainWindow::updateFileListing();
+        m_bUpdateFilesAfterClean = false;
+    }
+}
+
+// Hands free workers to the jobs, finishes the jobs that ran out of work
+// and ends the run once nothing is left
+void MainWindow::settleJobs()
+{
+    bool finished;
+    do
+    {
+        if (!scheduleTasks())
+        {
+            abortRun();
+            reportStartFailure();
+        }
+        finished = false;
+        for (CleanJob *job : qAsConst(m_jobs))
+        {
+            if (job->state == CleanJob::Running && (!job->watched || job->aborted) && !job->hasQueuedTasks() && !job->commitsPending && !jobWorkers(job->id))
+            {
+                finishJob(job);
+                finished = true;
+            }
+        }
+    } while (finished);
+
+    if (!m_bRunActive || !m_workers.isEmpty())
+        return;
+    for (const CleanJob *job : qAsConst(m_jobs))
+    {
+        // Queued jobs are only left over while paused
+        if (job->isActive() || job->state == CleanJob::Queued)
+            return;
+    }
+    finishRun();
+}
+
+void MainWindow::beginRun()
+{
+    if (m_bRunActive)
+        return;
+    m_bRunActive = true;
+    m_nDecompileWorkers = ui->decompileWorkersSpin->value();
+    m_nCleanWorkers = ui->cleanWorkersSpin->value();
+    m_processLimits = savedProcessLimits();
+    QSettings settings(QCoreApplication::organizationName(), QCoreApplication::applicationName());
+    m_pPrefetcher->setBudget(settings.value("prefetchBudgetMB", 256).toLongLong() * 1024 * 1024);
+    m_agents = savedRemoteAgents();
+    if (!m_agents.isEmpty())
+    {
+        const QStringList agentPaths = {QCoreApplication::applicationDirPath(), QDir::currentPath()};
+        m_sAgentPath = QStandardPaths::findExecutable("cleanmodels-agent", agentPaths);
+        if (m_sAgentPath.isEmpty())
+            m_sAgentPath = QStandardPaths::findExecutable("cleanmodels-agent");
+        if (m_sAgentPath.isEmpty())
+        {
+            appendLog(ui->debugTextBrowser, "<p><span style=\"color:red;\">" % tr("cleanmodels-agent was not found next to the front end or in your PATH, the remote agents are left out.") % "</span></p><br>");
+            m_agents.clear();
+        }
+    }
+    m_sAgentToken = savedAgentToken();
+    if (!m_agents.isEmpty() && m_sAgentToken.isEmpty())
+    {
+        appendLog(ui->debugTextBrowser, "<p><span style=\"color:red;\">" % tr("No token is set under Run > Remote Agents, the remote agents are left out.") % "</span></p><br>");
+        m_agents.clear();
+    }
+    // Only on request, the upstream CLI has no --serve. With it, watch mode
+    // keeps a worker warm between the models that land.
+    m_bPersistentWorkers = ui->actionPersistentWorkers->isChecked();
+    // Adaptive runs start small and grow while the system keeps up
+    m_nWorkerBudget = m_nDecompileWorkers + m_nCleanWorkers;
+    m_nPeakWorkerRssKb = 0;
+    if (ui->adaptiveWorkersCheck->isChecked() && m_loadMonitor.sample().valid)
+        m_nWorkerBudget = qMin(m_nWorkerBudget, 2);
+    m_pLoadTimer->start();
+    ui->actionPause->setEnabled(true);
+}
+
+void MainWindow::on_queueCurrentButton_released()
+{
+    CleanJob *job = newJob();
+    if (!editJob(job))
+    {
+        delete job;
+        return;
+    }
+    addJob(job);
+    settleJobs();
+}
+
+void MainWindow::on_queuePresetButton_released()
+{
+    QFileDialog fileDialog;
+    fileDialog.setAcceptMode(QFileDialog::AcceptMode::AcceptOpen);
+    QStringList nameFilters;
+    nameFilters.append("Clean Models Config (*.cm)");
+    fileDialog.setNameFilters(nameFilters);
+    fileDialog.setDirectory(QDir::currentPath());
+    if (!fileDialog.exec())
+        return;
+    QString fileName = fileDialog.selectedFiles()[0];
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        QMessageBox::information(this, tr("Unable to open file"), file.errorString());
+        return;
+    }
+    // The preset is the job's options, folders and pattern default to its own
+    CleanJob *job = newJob();
+    job->options = file.readAll();
+    job->name = QFileInfo(fileName).completeBaseName();
+    const QString inDir = coreOption(job->options, "g_indir");
+    const QString outDir = coreOption(job->options, "g_outdir");
+    const QString pattern = coreOption(job->options, "g_pattern");
+    if (!inDir.isEmpty())
+        job->inDir = inDir;
+    if (!outDir.isEmpty())
+        job->outDir = outDir;
+    if (!pattern.isEmpty())
+        job->pattern = pattern;
+    if (!editJob(job))
+    {
+        delete job;
+        return;
+    }
+    addJob(job);
+    settleJobs();
+}
+
+void MainWindow::on_removeJobButton_released()
+{
+    const int row = ui->jobsTable->currentRow();
+    if (row < 0 || row >= m_jobs.count())
+        return;
+    CleanJob *job = m_jobs.at(row);
+    if (job->isActive())
+    {
+        // Running jobs are aborted first and stay listed with their results
+        abortJob(job);
+        settleJobs();
+        return;
+    }
+    m_jobs.removeAt(row);
+    ui->jobsTable->removeRow(row);
+    delete job->page;
+    delete job;
+}
+
+void MainWindow::on_jobsTable_currentCellChanged(int currentRow, int, int, int)
+{
+    if (currentRow < 0 || currentRow >= m_jobs.count())
+        return;
+    const CleanJob *job = m_jobs.at(currentRow);
+    ui->jobResultsStack->setCurrentWidget(job->page ? job->page : ui->jobViewPage);
+}
@@ -0,0 +1,305 @@
+﻿#include "mainwindow.h"
+#include "ui_mainwindow.h"
+#include "mdldiffdialog.h"
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QHeaderView>
+#include <QLabel>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QSaveFile>
+#include <QStringBuilder>
+#include <QTableWidget>
+#include <QTextStream>
+#include <QVBoxLayout>
+#include <memory>
+
+namespace
+{
+// What the cleaner's render options change, in report column order
+const int MetricCount = 6;
+
+const char *metricName(int metric)
+{
+    static const char *names[MetricCount] = {"Meshes", "Verts", "Faces", "Render", "Shadow", "Bitmaps"};
+    return names[metric];
+}
+
+qint64 metricValue(const MdlStats& stats, int metric)
+{
+    switch (metric)
+    {
+    case 0:
+        return stats.meshes;
+    case 1:
+        return stats.verts;
+    case 2:
+        return stats.faces;
+    case 3:
+        return stats.renderNodes;
+    case 4:
+        return stats.shadowNodes;
+    default:
+        return stats.bitmaps;
+    }
+}
+
+QTableWidgetItem *numberItem(qint64 value)
+{
+    auto *item = new QTableWidgetItem();
+    item->setData(Qt::DisplayRole, QVariant(qlonglong(value)));
+    item->setTextAlignment(Qt::AlignCenter);
+    return item;
+}
+
+// Archives are closed again right away, the model is copied out of them
+bool openOutline(MdlOutline& outline, const QString& root, const QString& model, QString *error)
+{
+    if (!ErfArchive::isArchivePath(root))
+        return outline.open(root % "/" % model, error);
+    ErfArchive archive;
+    if (!archive.open(root))
+    {
+        *error = archive.errorString();
+        return false;
+    }
+    for (int i = 0; i < archive.entries().count(); ++i)
+    {
+        if (archive.resourceFileName(i).compare(model, Qt::CaseInsensitive) != 0)
+            continue;
+        const QByteArray data = archive.resourceData(i);
+        if (!DirWalker::isASCIIHeader(data.left(256)))
+        {
+            *error = QObject::tr("not an ASCII model");
+            return false;
+        }
+        outline.setData(QByteArray(data.constData(), data.size()));
+        return true;
+    }
+    *error = QObject::tr("not in ") % root;
+    return false;
+}
+
+QString csvField(const QString& text)
+{
+    if (!text.contains(',') && !text.contains('"'))
+        return text;
+    return '"' % QString(text).replace("\"", "\"\"") % '"';
+}
+}
+
+
+// Profiles the inputs of a finished job and the models it wrote, both on
+// the scanners' thread pools, and reports what cleaning saved the renderer
+void MainWindow::onRenderCostTriggered()
+{
+    const int selected = ui->jobsTable->currentRow();
+    CleanJob *job = selected >= 0 && selected < m_jobs.count() ? m_jobs.at(selected) : (m_jobs.isEmpty() ? nullptr : m_jobs.last());
+    if (!job || job->isActive() || job->state == CleanJob::Queued || job->decompileOnly || job->entries.isEmpty())
+    {
+        QMessageBox::information(this, tr("Render Cost Report"), tr("Select a job that has finished cleaning."));
+        return;
+    }
+
+    // Archives are opened afresh, the job's own ones are closed when it finishes
+    auto inArchive = std::make_shared<ErfArchive>();
+    auto outArchive = std::make_shared<ErfArchive>();
+    if (ErfArchive::isArchivePath(job->inDir) && !inArchive->open(job->inDir))
+    {
+        QMessageBox::warning(this, tr("Render Cost Report"), tr("Could not read archive ") % job->inDir % ": " % inArchive->errorString());
+        return;
+    }
+    const bool archiveOut = ErfArchive::isArchivePath(job->outDir);
+    if (archiveOut && !outArchive->open(job->outDir))
+    {
+        QMessageBox::warning(this, tr("Render Cost Report"), tr("Could not read archive ") % job->outDir % ": " % outArchive->errorString());
+        return;
+    }
+    QHash<QString, int> outIndex;
+    if (archiveOut)
+    {
+        for (int i = 0; i < outArchive->entries().count(); ++i)
+            outIndex.insert(outArchive->resourceFileName(i).toLower(), i);
+    }
+    QVector<ModelEntry> outputs;
+    outputs.reserve(job->entries.count());
+    for (const ModelEntry &entry : qAsConst(job->entries))
+    {
+        ModelEntry output;
+        output.relPath = entry.relPath;
+        output.isASCII = true;
+        output.archiveIndex = archiveOut ? outIndex.value(QFileInfo(entry.relPath).fileName().toLower(), -1) : -1;
+        outputs.append(output);
+    }
+
+    auto *before = new MdlStatsScanner(this);
+    auto *after = new MdlStatsScanner(this);
+    auto pending = std::make_shared<int>(2);
+    const QString jobName = job->name;
+    auto scanned = [this, before, after, pending, inArchive, outArchive, jobName]() {
+        if (--*pending)
+            return;
+        if (!m_bRunActive)
+            m_pCleanStatus->setText(tr("Idle"));
+        showRenderCostReport(jobName, after->entries(), before->stats(), after->stats());
+        before->deleteLater();
+        after->deleteLater();
+    };
+    connect(before, &MdlStatsScanner::finished, this, scanned, Qt::QueuedConnection);
+    connect(after, &MdlStatsScanner::finished, this, scanned, Qt::QueuedConnection);
+    m_pCleanStatus->setText(tr("Comparing ") % job->name);
+    before->start(job->entries, job->inDir, inArchive->isOpen() ? inArchive.get() : nullptr);
+    after->start(outputs, job->outDir, archiveOut ? outArchive.get() : nullptr);
+}
+
+void MainWindow::showRenderCostReport(const QString& jobName, const QVector<ModelEntry>& entries,
+                                      const QVector<MdlStats>& before, const QVector<MdlStats>& after)
+{
+    auto *dialog = new QDialog(this);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    dialog->setWindowTitle(tr("Render Cost of %1").arg(jobName));
+    auto *layout = new QVBoxLayout(dialog);
+    auto *totalsLabel = new QLabel(dialog);
+    totalsLabel->setWordWrap(true);
+    layout->addWidget(totalsLabel);
+
+    // Every metric gets the cleaned value and its change, binary inputs
+    // cannot be profiled and only show the cleaned value
+    auto *table = new QTableWidget(0, 1 + 2 * MetricCount, dialog);
+    QStringList headers(tr("Model"));
+    for (int metric = 0; metric < MetricCount; ++metric)
+        headers << tr(metricName(metric)) << tr(metricName(metric)) % tr(" change");
+    table->setHorizontalHeaderLabels(headers);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->setAlternatingRowColors(true);
+    table->verticalHeader()->setVisible(false);
+    table->verticalHeader()->setDefaultSectionSize(20);
+    table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    for (int column = 1; column < table->columnCount(); ++column)
+        table->setColumnWidth(column, 70);
+
+    qint64 totalBefore[MetricCount] = {};
+    qint64 totalAfter[MetricCount] = {};
+    int compared = 0;
+    for (int i = 0; i < entries.count(); ++i)
+    {
+        if (!after.at(i).valid)
+            continue;
+        const int row = table->rowCount();
+        table->insertRow(row);
+        table->setItem(row, 0, new QTableWidgetItem(entries.at(i).relPath));
+        const bool hasBefore = before.at(i).valid;
+        compared += hasBefore;
+        for (int metric = 0; metric < MetricCount; ++metric)
+        {
+            const qint64 value = metricValue(after.at(i), metric);
+            table->setItem(row, 1 + 2 * metric, numberItem(value));
+            if (!hasBefore)
+                continue;
+            const qint64 original = metricValue(before.at(i), metric);
+            table->setItem(row, 2 + 2 * metric, numberItem(value - original));
+            totalBefore[metric] += original;
+            totalAfter[metric] += value;
+        }
+    }
+    table->setSortingEnabled(true);
+    layout->addWidget(table);
+
+    QStringList totals;
+    for (int metric = 0; metric < MetricCount; ++metric)
+    {
+        const double change = totalBefore[metric] ? 100.0 * double(totalAfter[metric] - totalBefore[metric]) / double(totalBefore[metric]) : 0.0;
+        totals << tr("%1 %2 → %3 (%4%)").arg(tr(metricName(metric))).arg(totalBefore[metric]).arg(totalAfter[metric]).arg(change, 0, 'f', 1);
+    }
+    totalsLabel->setText(tr("%1 cleaned models, %2 compared with their input. ").arg(table->rowCount()).arg(compared) % totals.join(", "));
+
+    auto *buttons = new QDialogButtonBox(QDialogButtonBox::Close, dialog);
+    QPushButton *exportButton = buttons->addButton(tr("Export CSV..."), QDialogButtonBox::ActionRole);
+    layout->addWidget(buttons);
+    connect(buttons, &QDialogButtonBox::rejected, dialog, &QDialog::reject);
+    connect(exportButton, &QPushButton::clicked, dialog, [dialog, entries, before, after]() {
+        const QString path = QFileDialog::getSaveFileName(dialog, tr("Export Render Cost Report"), QString(), tr("CSV files (*.csv)"));
+        if (path.isEmpty())
+            return;
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        {
+            QMessageBox::warning(dialog, tr("Export Render Cost Report"), tr("Could not write ") % path % ": " % file.errorString());
+            return;
+        }
+        QTextStream out(&file);
+        out << "model";
+        for (int metric = 0; metric < MetricCount; ++metric)
+        {
+            const QString name = QString::fromLatin1(metricName(metric)).toLower();
+            out << ',' << name << "_before," << name << "_after," << name << "_change";
+        }
+        out << '\n';
+        for (int i = 0; i < entries.count(); ++i)
+        {
+            if (!after.at(i).valid)
+                continue;
+            out << csvField(entries.at(i).relPath);
+            for (int metric = 0; metric < MetricCount; ++metric)
+            {
+                const qint64 value = metricValue(after.at(i), metric);
+                if (before.at(i).valid)
+                {
+                    const qint64 original = metricValue(before.at(i), metric);
+                    out << ',' << original << ',' << value << ',' << value - original;
+                }
+                else
+                {
+                    out << ",," << value << ',';
+                }
+            }
+            out << '\n';
+        }
+        out.flush();
+        if (!file.commit())
+            QMessageBox::warning(dialog, tr("Export Render Cost Report"), tr("Could not write ") % path % ": " % file.errorString());
+    });
+    dialog->resize(1000, 560);
+    dialog->show();
+}
+
+void MainWindow::compareModel()
+{
+    const QList<QTableWidgetItem*> selected = ui->filesTable->selectedItems();
+    QTableWidgetItem *fileItem = selected.isEmpty() ? nullptr : ui->filesTable->item(selected.first()->row(), 0);
+    if (!fileItem)
+        return;
+    const QString model = fileItem->text();
+
+    // The latest run of the main window knows where the row was written to
+    QString inDir = m_sInDir;
+    QString outDir = m_sOutDir;
+    for (int i = m_jobs.count() - 1; i >= 0; --i)
+    {
+        if (m_jobs.at(i)->table == ui->filesTable)
+        {
+            inDir = m_jobs.at(i)->inDir;
+            outDir = m_jobs.at(i)->outDir;
+            break;
+        }
+    }
+
+    std::unique_ptr<MdlOutline> input(new MdlOutline);
+    std::unique_ptr<MdlOutline> output(new MdlOutline);
+    QString error;
+    if (!openOutline(*input, inDir, model, &error))
+    {
+        QMessageBox::warning(this, tr("Compare Models"), tr("Could not read the input of ") % model % ": " % error);
+        return;
+    }
+    if (!openOutline(*output, outDir, model, &error))
+    {
+        QMessageBox::warning(this, tr("Compare Models"), tr("Could not read the output of ") % model % ": " % error);
+        return;
+    }
+    auto *dialog = new MdlDiffDialog(std::move(input), std::move(output), model, this);
+    dialog->show();
+}
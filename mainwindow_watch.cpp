@@ -0,0 +1,273 @@
+﻿#include "mainwindow.h"
+#include "ui_mainwindow.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSettings>
+#include <QStringBuilder>
+#include <algorithm>
+
+namespace
+{
+// Ticks of the watch timer a landed model must stay unchanged for before
+// it is cleaned, exporters write in more than one go
+const int StableTicks = 2;
+}
+
+void MainWindow::onWatchModeToggled(bool checked)
+{
+    QSettings settings(QCoreApplication::organizationName(), QCoreApplication::applicationName());
+    settings.setValue("watchMode", checked);
+    if (checked)
+    {
+        startWatching();
+        updateFileListing();
+    }
+    else
+    {
+        stopWatching();
+    }
+}
+
+void MainWindow::startWatching()
+{
+    if (m_bWatching)
+        return;
+    // Cleaned models landing in the watched folder would be cleaned again
+    const QString inRoot = QDir(m_sInDir).absolutePath();
+    const QString outRoot = QDir(m_sOutDir).absolutePath();
+    if (ErfArchive::isArchivePath(m_sInDir) || ErfArchive::isArchivePath(m_sOutDir) ||
+        outRoot == inRoot || outRoot.startsWith(inRoot % "/"))
+    {
+        appendLog(ui->debugTextBrowser, "<p><span style=\"color:red;\">" % tr("Watch mode needs an input folder and an output folder outside of it.") % "</span></p><br>");
+        QSignalBlocker blockWatch(ui->actionWatchMode);
+        ui->actionWatchMode->setChecked(false);
+        return;
+    }
+    m_bWatching = true;
+    m_bWatchBaseline = false;
+    m_watchSeen.clear();
+    m_watchPending.clear();
+    m_watchChanged.clear();
+    watchFolders(m_sInDir);
+    appendLog(ui->debugTextBrowser, tr("Watching ") % m_sInDir % tr(" for new and changed models.<br>"));
+    m_pWatchTimer->start();
+}
+
+void MainWindow::stopWatching()
+{
+    if (!m_bWatching)
+        return;
+    m_bWatching = false;
+    m_pWatchTimer->stop();
+    m_watchSeen.clear();
+    m_watchPending.clear();
+    m_watchChanged.clear();
+    if (!m_watchFolders.isEmpty())
+        m_fsWatcher.removePaths(m_watchFolders.values());
+    m_watchFolders.clear();
+    // The watch job finishes the models it has and lets its warm worker go
+    if (CleanJob *job = findJob(m_nWatchJobId))
+    {
+        job->watched = false;
+        if (job->state == CleanJob::Queued)
+            abortJob(job);
+    }
+    m_nWatchJobId = 0;
+    appendLog(ui->debugTextBrowser, tr("Stopped watching ") % m_sInDir % "<br>");
+    settleJobs();
+}
+
+// The job the landed models go to, a new one when the last was aborted
+CleanJob *MainWindow::watchJob()
+{
+    CleanJob *job = findJob(m_nWatchJobId);
+    if (job && job->watched && !job->aborted && (job->state == CleanJob::Queued || job->isActive()))
+        return job;
+    job = newJob();
+    job->name = tr("Watch ") % job->name;
+    job->priority = -99; // background, every other job goes first
+    job->dedupe = false;
+    job->watched = true;
+    addJob(job);
+    m_nWatchJobId = job->id;
+    return job;
+}
+
+// With Persistent Workers on, a worker started on an empty chunk loads the
+// options and then waits for the first model to land
+void MainWindow::warmWatchWorker(CleanJob *job)
+{
+    if (!m_bPersistentWorkers || !job->runDir)
+        return;
+    CleanTask task;
+    task.stage = job->decompileOnly ? CleanTask::Decompile : CleanTask::Clean;
+    task.jobId = job->id;
+    task.inDir = job->runDir->filePath("warmup");
+    task.outDir = job->stageDir ? job->stageDir->path() : job->runDir->filePath("out");
+    task.pattern = job->pattern;
+    task.generatedOptions = true;
+    QDir().mkpath(task.inDir);
+    if (task.stage == CleanTask::Decompile)
+        job->decompileQueue.append(task);
+    else
+        job->cleanQueue.append(task);
+}
+
+// The input folder itself is always watched, its subfolders only when the
+// listing is recursive
+void MainWindow::watchFolders(const QString& dirPath)
+{
+    if (dirPath != m_sInDir && !m_watchFolders.contains(dirPath) && m_fsWatcher.addPath(dirPath))
+        m_watchFolders.insert(dirPath);
+    if (!ui->recursiveCheck->isChecked())
+        return;
+    const QStringList subDirs = QDir(dirPath).entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::Readable | QDir::NoSymLinks);
+    for (const QString &subDir : subDirs)
+    {
+        if (!subDir.startsWith('.'))
+            watchFolders(dirPath % "/" % subDir);
+    }
+}
+
+// Only the folders that changed are listed, by size and time. A folder new
+// to a recursive watch is watched from now on and listed along with the
+// folders below it, since it may have been moved in whole.
+void MainWindow::scanWatchedFolders()
+{
+    if (!m_bWatchBaseline)
+        return;
+    QStringList folders = m_watchChanged.values();
+    m_watchChanged.clear();
+    QSet<QString> listed;
+    QVector<ModelEntry> entries;
+    while (!folders.isEmpty())
+    {
+        const QString path = folders.takeLast();
+        const QString dirPath = QFileInfo(path).isDir() ? path : QFileInfo(path).path();
+        if ((dirPath != m_sInDir && !dirPath.startsWith(m_sInDir % "/")) || listed.contains(dirPath))
+            continue;
+        listed.insert(dirPath);
+        const QString relDir = dirPath == m_sInDir ? QString() : dirPath.mid(m_sInDir.length() + 1);
+        QDir dir(dirPath);
+        if (ui->recursiveCheck->isChecked())
+        {
+            const QStringList subDirs = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::Readable | QDir::NoSymLinks);
+            for (const QString &subDir : subDirs)
+            {
+                const QString subPath = dirPath % "/" % subDir;
+                if (subDir.startsWith('.') || m_watchFolders.contains(subPath))
+                    continue;
+                if (m_fsWatcher.addPath(subPath))
+                    m_watchFolders.insert(subPath);
+                folders.append(subPath);
+            }
+        }
+        dir.setNameFilters(QStringList(ui->filePattern->text()));
+        const QFileInfoList files = dir.entryInfoList(QDir::Files | QDir::NoDotAndDotDot | QDir::Readable | QDir::CaseSensitive);
+        for (const QFileInfo &fileInfo : files)
+        {
+            ModelEntry entry;
+            entry.relPath = relDir.isEmpty() ? fileInfo.fileName() : relDir % "/" % fileInfo.fileName();
+            entry.size = fileInfo.size();
+            entry.modified = fileInfo.lastModified().toMSecsSinceEpoch();
+            entries.append(entry);
+        }
+    }
+    noteWatchedEntries(entries);
+}
+
+void MainWindow::noteWatchedEntries(const QVector<ModelEntry>& entries)
+{
+    // What is there when watching starts counts as done
+    if (!m_bWatchBaseline)
+    {
+        m_bWatchBaseline = true;
+        for (const ModelEntry &entry : entries)
+            m_watchSeen.insert(entry.relPath, qMakePair(entry.size, entry.modified));
+        watchJob();
+        // Anything that changed while the baseline was listed
+        scanWatchedFolders();
+        settleJobs();
+        return;
+    }
+    for (const ModelEntry &entry : entries)
+    {
+        if (m_watchSeen.value(entry.relPath) == qMakePair(entry.size, entry.modified) || m_watchPending.contains(entry.relPath))
+            continue;
+        WatchedModel landed;
+        landed.entry = entry;
+        m_watchPending.insert(entry.relPath, landed);
+    }
+}
+
+// Models still being written keep changing size or time, the others are
+// handed to the watch job
+void MainWindow::onWatchTimer()
+{
+    QVector<ModelEntry> ready;
+    for (auto it = m_watchPending.begin(); it != m_watchPending.end();)
+    {
+        const QFileInfo info(m_sInDir % "/" % it.key());
+        if (!info.exists())
+        {
+            it = m_watchPending.erase(it);
+            continue;
+        }
+        const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+        if (info.size() != it->entry.size || modified != it->entry.modified)
+        {
+            it->entry.size = info.size();
+            it->entry.modified = modified;
+            it->stableTicks = 0;
+        }
+        else if (++it->stableTicks >= StableTicks)
+        {
+            ready.append(it->entry);
+            it = m_watchPending.erase(it);
+            continue;
+        }
+        ++it;
+    }
+    if (!ready.isEmpty())
+        enqueueWatched(ready);
+}
+
+void MainWindow::enqueueWatched(QVector<ModelEntry> entries)
+{
+    for (ModelEntry &entry : entries)
+    {
+        // The header may not have been written yet when the folder was listed
+        QFile file(m_sInDir % "/" % entry.relPath);
+        if (file.open(QIODevice::ReadOnly))
+            entry.isASCII = DirWalker::isASCIIHeader(file.read(256));
+        m_watchSeen.insert(entry.relPath, qMakePair(entry.size, entry.modified));
+    }
+    CleanJob *job = watchJob();
+    for (const ModelEntry &entry : qAsConst(entries))
+    {
+        auto known = std::find_if(job->entries.begin(), job->entries.end(), [&entry](const ModelEntry& other) {
+            return other.relPath == entry.relPath;
+        });
+        if (known != job->entries.end())
+            *known = entry;
+        else
+            job->entries.append(entry);
+    }
+    appendJobLog(job, QString::number(entries.count()) % tr(" models landed in ") % job->inDir % "<br>");
+    // A job that has not started yet takes them along when it does
+    if (job->state == CleanJob::Running)
+    {
+        appendResultRows(job->table, entries, job->items);
+        const QList<CleanTask> tasks = buildCleanTasks(job, entries, ++m_nWatchBatch);
+        for (const CleanTask &task : tasks)
+        {
+            if (task.stage == CleanTask::Decompile)
+                job->decompileQueue.append(task);
+            else
+                job->cleanQueue.append(task);
+        }
+        updateJobRow(job);
+    }
+    settleJobs();
+}
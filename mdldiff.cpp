@@ -0,0 +1,232 @@
+#include "mdldiff.h"
+#include "dirwalker.h"
+#include <QObject>
+#include <QSet>
+#include <cstring>
+
+namespace
+{
+bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+bool isLetter(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+// The first words of a line, at most count of them
+QList<QByteArray> lineWords(const char *pos, const char *lineEnd, int count)
+{
+    QList<QByteArray> words;
+    while (pos < lineEnd && words.count() < count)
+    {
+        while (pos < lineEnd && isBlank(*pos))
+            ++pos;
+        const char *wordEnd = pos;
+        while (wordEnd < lineEnd && !isBlank(*wordEnd))
+            ++wordEnd;
+        if (wordEnd > pos)
+            words.append(QByteArray(pos, int(wordEnd - pos)));
+        pos = wordEnd;
+    }
+    return words;
+}
+
+const char *firstNonBlank(const char *pos, const char *lineEnd)
+{
+    while (pos < lineEnd && isBlank(*pos))
+        ++pos;
+    return pos;
+}
+
+// Lists whose rows are counted on the keyword line, their rows may start
+// with a letter, bone names in weights for one
+bool isCountedList(const QByteArray& keyword)
+{
+    static const QSet<QByteArray> lists = {"verts", "faces", "tverts", "tverts1", "tverts2", "tverts3", "weights",
+                                           "constraints", "colors", "animverts", "animtverts", "texindices1",
+                                           "texindices2", "texindices3", "multimaterial"};
+    return lists.contains(keyword);
+}
+}
+
+bool MdlOutline::open(const QString& path, QString *error)
+{
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly))
+    {
+        *error = m_file.errorString();
+        return false;
+    }
+    if (DirWalker::isASCIIHeader(m_file.peek(256)) == false)
+    {
+        *error = QObject::tr("not an ASCII model");
+        return false;
+    }
+    const qint64 size = m_file.size();
+    if (uchar *mapped = size > 0 && size < 0x7fffffff ? m_file.map(0, size) : nullptr)
+        m_data = QByteArray::fromRawData(reinterpret_cast<const char*>(mapped), int(size));
+    else
+        m_data = m_file.readAll();
+    index();
+    return true;
+}
+
+void MdlOutline::setData(const QByteArray& data)
+{
+    m_data = data;
+    index();
+}
+
+QByteArray MdlOutline::block(const MdlNodeSpan& node) const
+{
+    return QByteArray::fromRawData(m_data.constData() + node.begin, node.end - node.begin);
+}
+
+void MdlOutline::index()
+{
+    m_nodes.clear();
+    const char *data = m_data.constData();
+    const int size = m_data.size();
+    QByteArray section = "geometry";
+    // The model header runs up to beginmodelgeom, an animation's header up
+    // to its first node
+    MdlNodeSpan header;
+    header.section = "model";
+    header.type = "header";
+    int openHeader = m_nodes.count();
+    m_nodes.append(header);
+    int openNode = -1;
+    int pos = 0;
+    while (pos < size)
+    {
+        const char *lineStart = data + pos;
+        const char *newline = static_cast<const char*>(memchr(lineStart, '\n', size_t(size - pos)));
+        const char *lineEnd = newline ? newline : data + size;
+        const int next = newline ? int(newline - data) + 1 : size;
+        const char *word = firstNonBlank(lineStart, lineEnd);
+        // Data rows start with a digit or a sign and are passed over
+        if (word < lineEnd && isLetter(*word))
+        {
+            const QList<QByteArray> words = lineWords(word, lineEnd, 3);
+            const QByteArray keyword = words.first().toLower();
+            if (keyword == "node" && words.count() >= 3)
+            {
+                if (openHeader >= 0)
+                {
+                    m_nodes[openHeader].end = pos;
+                    openHeader = -1;
+                }
+                MdlNodeSpan node;
+                node.section = section;
+                node.type = words.at(1).toLower();
+                node.name = words.at(2);
+                node.begin = pos;
+                openNode = m_nodes.count();
+                m_nodes.append(node);
+            }
+            else if (keyword == "endnode" && openNode >= 0)
+            {
+                m_nodes[openNode].end = next;
+                openNode = -1;
+            }
+            else if (keyword == "parent" && openNode >= 0 && words.count() >= 2)
+            {
+                m_nodes[openNode].parent = words.at(1);
+            }
+            else if (keyword == "beginmodelgeom" && openHeader >= 0)
+            {
+                m_nodes[openHeader].end = pos;
+                openHeader = -1;
+            }
+            else if (keyword == "newanim" && words.count() >= 2)
+            {
+                section = words.at(1);
+                MdlNodeSpan animation;
+                animation.section = section;
+                animation.type = "animation";
+                animation.name = section;
+                animation.begin = pos;
+                openHeader = m_nodes.count();
+                m_nodes.append(animation);
+            }
+            else if (keyword == "doneanim" && openHeader >= 0)
+            {
+                m_nodes[openHeader].end = next;
+                openHeader = -1;
+            }
+        }
+        pos = next;
+    }
+    if (openHeader >= 0)
+        m_nodes[openHeader].end = size;
+    if (openNode >= 0)
+        m_nodes[openNode].end = size;
+}
+
+QVector<MdlProperty> MdlOutline::properties(const MdlNodeSpan& node) const
+{
+    QVector<MdlProperty> properties;
+    const char *data = m_data.constData();
+    int pos = node.begin;
+    int pendingRows = 0;
+    bool firstLine = node.type != "header" && node.type != "animation";
+    while (pos < node.end)
+    {
+        const char *lineStart = data + pos;
+        const char *newline = static_cast<const char*>(memchr(lineStart, '\n', size_t(node.end - pos)));
+        const char *lineEnd = newline ? newline : data + node.end;
+        const int next = newline ? int(newline - data) + 1 : node.end;
+        const char *word = firstNonBlank(lineStart, lineEnd);
+        if (firstLine || word == lineEnd || *word == '#')
+        {
+            // The node line itself is already in the outline
+            firstLine = false;
+        }
+        else if ((pendingRows > 0 || !isLetter(*word)) && !properties.isEmpty())
+        {
+            MdlProperty &property = properties.last();
+            if (!property.rowCount)
+                property.rowsBegin = pos;
+            property.rowsEnd = next;
+            ++property.rowCount;
+            pendingRows = qMax(0, pendingRows - 1);
+        }
+        else
+        {
+            const QList<QByteArray> words = lineWords(word, lineEnd, 2);
+            const QByteArray keyword = words.first().toLower();
+            if (keyword != "endnode" && keyword != "endlist")
+            {
+                MdlProperty property;
+                property.keyword = keyword;
+                property.value = QByteArray(word, int(lineEnd - word)).mid(words.first().size()).trimmed();
+                pendingRows = isCountedList(keyword) && words.count() > 1 ? words.at(1).toInt() : 0;
+                properties.append(property);
+            }
+        }
+        pos = next;
+    }
+    return properties;
+}
+
+QByteArray MdlOutline::rowData(const MdlProperty& property) const
+{
+    return QByteArray::fromRawData(m_data.constData() + property.rowsBegin, property.rowsEnd - property.rowsBegin);
+}
+
+QList<QByteArray> MdlOutline::rows(const MdlProperty& property) const
+{
+    QList<QByteArray> rows;
+    if (!property.rowCount)
+        return rows;
+    for (const QByteArray &row : rowData(property).split('\n'))
+    {
+        const QByteArray trimmed = row.simplified();
+        if (!trimmed.isEmpty())
+            rows.append(trimmed);
+    }
+    return rows;
+}
@@ -0,0 +1,58 @@
+#ifndef MDLDIFF_H
+#define MDLDIFF_H
+#include <QByteArray>
+#include <QList>
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+// A block of an ASCII model: a node from its node line to its endnode line,
+// or the header lines of the model or of an animation
+struct MdlNodeSpan
+{
+    QByteArray section; // "geometry" or the animation's name
+    QByteArray type;
+    QByteArray name;
+    QByteArray parent;
+    int begin = 0;
+    int end = 0;
+};
+
+// A keyword line of a node and the data rows that follow it
+struct MdlProperty
+{
+    QByteArray keyword;
+    QByteArray value;
+    int rowsBegin = 0;
+    int rowsEnd = 0;
+    int rowCount = 0;
+};
+
+// Where the blocks of an ASCII model are. Opening makes one pass that keeps
+// names and offsets only, block contents are taken from the mapped file
+// when somebody asks for them.
+class MdlOutline
+{
+public:
+    MdlOutline() = default;
+    MdlOutline(const MdlOutline&) = delete;
+    MdlOutline& operator=(const MdlOutline&) = delete;
+
+    bool open(const QString& path, QString *error);
+    void setData(const QByteArray& data);
+
+    const QVector<MdlNodeSpan>& nodes() const { return m_nodes; }
+    QByteArray block(const MdlNodeSpan& node) const;
+    QVector<MdlProperty> properties(const MdlNodeSpan& node) const;
+    QByteArray rowData(const MdlProperty& property) const;
+    QList<QByteArray> rows(const MdlProperty& property) const;
+
+private:
+    void index();
+
+    QFile m_file;
+    QByteArray m_data;
+    QVector<MdlNodeSpan> m_nodes;
+};
+
+#endif // MDLDIFF_H
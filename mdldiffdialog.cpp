@@ -0,0 +1,293 @@
+#include "mdldiffdialog.h"
+#include <QDialogButtonBox>
+#include <QHash>
+#include <QHeaderView>
+#include <QLabel>
+#include <QStringBuilder>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+namespace
+{
+enum Column { NameColumn, TypeColumn, StatusColumn, InputColumn, OutputColumn };
+enum ItemKind { SectionItem, NodeItem, PropertyItem, InfoItem };
+enum Role { KindRole = Qt::UserRole, InputRole, OutputRole };
+
+// Rows listed per expanded list, the rest is summed up
+const int MaxRowsShown = 200;
+
+// Headers are told apart from a node that happens to share their name, a
+// node whose type the cleaner changed still matches
+QString nodeKey(const MdlNodeSpan& node)
+{
+    const bool header = node.type == "header" || node.type == "animation";
+    return QString::fromLatin1(node.section % '\n' % (header ? node.type : QByteArray()) % '\n' % node.name.toLower());
+}
+
+QTreeWidgetItem *infoItem(QTreeWidgetItem *parent, const QString& text)
+{
+    auto *item = new QTreeWidgetItem(parent);
+    item->setText(NameColumn, text);
+    item->setData(NameColumn, KindRole, InfoItem);
+    item->setForeground(NameColumn, QBrush(Qt::gray));
+    return item;
+}
+
+void setStatus(QTreeWidgetItem *item, const QString& status, const QColor& color)
+{
+    item->setText(StatusColumn, status);
+    item->setForeground(StatusColumn, QBrush(color));
+}
+
+QString sizeText(const MdlNodeSpan *node)
+{
+    return node ? QString::number(node->end - node->begin) % QObject::tr(" bytes") : QString();
+}
+
+QString propertyText(const MdlProperty *property)
+{
+    if (!property)
+        return QString();
+    QString text = QString::fromLatin1(property->value);
+    if (property->rowCount)
+        text += (text.isEmpty() ? QString() : QStringLiteral(" ")) % QObject::tr("[%n row(s)]", "", property->rowCount);
+    return text;
+}
+
+// Properties are matched by keyword and by how often the keyword came before
+QString propertyKey(const MdlProperty& property, QHash<QByteArray, int>& seen)
+{
+    return QString::fromLatin1(property.keyword) % '#' % QString::number(seen[property.keyword]++);
+}
+}
+
+MdlDiffDialog::MdlDiffDialog(std::unique_ptr<MdlOutline> input, std::unique_ptr<MdlOutline> output,
+                             const QString& model, QWidget *parent)
+    : QDialog(parent)
+    , m_pInput(std::move(input))
+    , m_pOutput(std::move(output))
+{
+    setAttribute(Qt::WA_DeleteOnClose);
+    setWindowTitle(tr("Compare %1").arg(model));
+    auto *layout = new QVBoxLayout(this);
+    m_pSummary = new QLabel(this);
+    m_pSummary->setWordWrap(true);
+    layout->addWidget(m_pSummary);
+
+    m_pTree = new QTreeWidget(this);
+    m_pTree->setHeaderLabels({tr("Node"), tr("Type"), tr("Status"), tr("Input"), tr("Output")});
+    m_pTree->setUniformRowHeights(true);
+    m_pTree->setAlternatingRowColors(true);
+    m_pTree->header()->setSectionResizeMode(QHeaderView::Interactive);
+    connect(m_pTree, &QTreeWidget::itemExpanded, this, &MdlDiffDialog::onItemExpanded);
+    layout->addWidget(m_pTree);
+
+    auto *buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    layout->addWidget(buttons);
+    resize(900, 600);
+
+    populate();
+}
+
+void MdlDiffDialog::populate()
+{
+    const QVector<MdlNodeSpan> &inNodes = m_pInput->nodes();
+    const QVector<MdlNodeSpan> &outNodes = m_pOutput->nodes();
+    QHash<QString, int> outIndex;
+    outIndex.reserve(outNodes.count());
+    for (int i = 0; i < outNodes.count(); ++i)
+        outIndex.insert(nodeKey(outNodes.at(i)), i);
+
+    // Nodes keep the input's order, those the cleaner added follow at the
+    // end of their section
+    QVector<QPair<int, int>> pairs;
+    QVector<bool> matched(outNodes.count(), false);
+    for (int i = 0; i < inNodes.count(); ++i)
+    {
+        const int j = outIndex.value(nodeKey(inNodes.at(i)), -1);
+        if (j >= 0 && !matched.at(j))
+        {
+            matched[j] = true;
+            pairs.append(qMakePair(i, j));
+        }
+        else
+        {
+            pairs.append(qMakePair(i, -1));
+        }
+    }
+    for (int j = 0; j < outNodes.count(); ++j)
+    {
+        if (!matched.at(j))
+            pairs.append(qMakePair(-1, j));
+    }
+
+    QHash<QByteArray, QTreeWidgetItem*> sections;
+    int changed = 0, removed = 0, added = 0;
+    for (const auto &pair : qAsConst(pairs))
+    {
+        const MdlNodeSpan *in = pair.first >= 0 ? &inNodes.at(pair.first) : nullptr;
+        const MdlNodeSpan *out = pair.second >= 0 ? &outNodes.at(pair.second) : nullptr;
+        const MdlNodeSpan &node = in ? *in : *out;
+        QTreeWidgetItem *&section = sections[node.section];
+        if (!section)
+        {
+            section = new QTreeWidgetItem(m_pTree);
+            section->setText(NameColumn, QString::fromLatin1(node.section));
+            section->setData(NameColumn, KindRole, SectionItem);
+            section->setFirstColumnSpanned(true);
+        }
+
+        auto *item = new QTreeWidgetItem(section);
+        item->setText(NameColumn, node.name.isEmpty() ? tr("(header)") : QString::fromLatin1(node.name));
+        item->setText(TypeColumn, QString::fromLatin1(node.type));
+        item->setText(InputColumn, sizeText(in));
+        item->setText(OutputColumn, sizeText(out));
+        item->setData(NameColumn, KindRole, NodeItem);
+        item->setData(NameColumn, InputRole, pair.first);
+        item->setData(NameColumn, OutputRole, pair.second);
+        if (!out)
+        {
+            setStatus(item, tr("Removed"), Qt::red);
+            ++removed;
+        }
+        else if (!in)
+        {
+            setStatus(item, tr("Added"), Qt::darkGreen);
+            ++added;
+        }
+        else if (m_pInput->block(*in) != m_pOutput->block(*out))
+        {
+            setStatus(item, tr("Changed"), QColor(255, 140, 0));
+            item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+            ++changed;
+            continue;
+        }
+        else
+        {
+            setStatus(item, tr("Same"), Qt::gray);
+            continue;
+        }
+        // Nodes on one side only list their properties as they are
+        item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+    }
+
+    for (QTreeWidgetItem *section : qAsConst(sections))
+        section->setExpanded(true);
+    m_pTree->resizeColumnToContents(NameColumn);
+    m_pSummary->setText(tr("%1 blocks in the input, %2 in the output: %3 changed, %4 removed, %5 added.")
+                        .arg(inNodes.count()).arg(outNodes.count()).arg(changed).arg(removed).arg(added));
+}
+
+void MdlDiffDialog::onItemExpanded(QTreeWidgetItem *item)
+{
+    if (item->childCount())
+        return;
+    const int kind = item->data(NameColumn, KindRole).toInt();
+    if (kind == NodeItem)
+        expandNode(item);
+    else if (kind == PropertyItem)
+        expandProperty(item);
+}
+
+void MdlDiffDialog::expandNode(QTreeWidgetItem *item)
+{
+    const int inNode = item->data(NameColumn, InputRole).toInt();
+    const int outNode = item->data(NameColumn, OutputRole).toInt();
+    const QVector<MdlProperty> inProperties = inNode >= 0 ? m_pInput->properties(m_pInput->nodes().at(inNode)) : QVector<MdlProperty>();
+    const QVector<MdlProperty> outProperties = outNode >= 0 ? m_pOutput->properties(m_pOutput->nodes().at(outNode)) : QVector<MdlProperty>();
+
+    QHash<QByteArray, int> seen;
+    QHash<QString, int> outIndex;
+    for (int j = 0; j < outProperties.count(); ++j)
+        outIndex.insert(propertyKey(outProperties.at(j), seen), j);
+
+    seen.clear();
+    QVector<bool> matched(outProperties.count(), false);
+    QVector<QPair<int, int>> pairs;
+    for (int i = 0; i < inProperties.count(); ++i)
+    {
+        const int j = outIndex.value(propertyKey(inProperties.at(i), seen), -1);
+        if (j >= 0)
+            matched[j] = true;
+        pairs.append(qMakePair(i, j));
+    }
+    for (int j = 0; j < outProperties.count(); ++j)
+    {
+        if (!matched.at(j))
+            pairs.append(qMakePair(-1, j));
+    }
+
+    const bool bothSides = inNode >= 0 && outNode >= 0;
+    int unchanged = 0;
+    for (const auto &pair : qAsConst(pairs))
+    {
+        const MdlProperty *in = pair.first >= 0 ? &inProperties.at(pair.first) : nullptr;
+        const MdlProperty *out = pair.second >= 0 ? &outProperties.at(pair.second) : nullptr;
+        bool rowsDiffer = false;
+        if (in && out)
+        {
+            rowsDiffer = in->rowCount != out->rowCount || m_pInput->rowData(*in) != m_pOutput->rowData(*out);
+            if (in->value == out->value && !rowsDiffer)
+            {
+                ++unchanged;
+                continue;
+            }
+        }
+
+        const MdlProperty &property = in ? *in : *out;
+        auto *child = new QTreeWidgetItem(item);
+        child->setText(NameColumn, QString::fromLatin1(property.keyword));
+        child->setText(InputColumn, propertyText(in));
+        child->setText(OutputColumn, propertyText(out));
+        child->setData(NameColumn, KindRole, PropertyItem);
+        child->setData(NameColumn, InputRole, pair.first);
+        child->setData(NameColumn, OutputRole, pair.second);
+        if (bothSides && !in)
+            setStatus(child, tr("Added"), Qt::darkGreen);
+        else if (bothSides && !out)
+            setStatus(child, tr("Removed"), Qt::red);
+        else if (bothSides)
+            setStatus(child, tr("Changed"), QColor(255, 140, 0));
+        if (rowsDiffer)
+            child->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+    }
+    if (unchanged)
+        infoItem(item, tr("Unchanged properties: %1").arg(unchanged));
+    if (!item->childCount())
+        infoItem(item, tr("Only whitespace differs"));
+}
+
+void MdlDiffDialog::expandProperty(QTreeWidgetItem *item)
+{
+    QTreeWidgetItem *node = item->parent();
+    const MdlNodeSpan &inNode = m_pInput->nodes().at(node->data(NameColumn, InputRole).toInt());
+    const MdlNodeSpan &outNode = m_pOutput->nodes().at(node->data(NameColumn, OutputRole).toInt());
+    const QVector<MdlProperty> inProperties = m_pInput->properties(inNode);
+    const QVector<MdlProperty> outProperties = m_pOutput->properties(outNode);
+    const QList<QByteArray> inRows = m_pInput->rows(inProperties.at(item->data(NameColumn, InputRole).toInt()));
+    const QList<QByteArray> outRows = m_pOutput->rows(outProperties.at(item->data(NameColumn, OutputRole).toInt()));
+
+    // Rows are compared by position, a list that changed length shows its
+    // extra rows as added or removed
+    const int rows = qMax(inRows.count(), outRows.count());
+    int differing = 0;
+    for (int row = 0; row < rows; ++row)
+    {
+        const QByteArray in = row < inRows.count() ? inRows.at(row) : QByteArray();
+        const QByteArray out = row < outRows.count() ? outRows.at(row) : QByteArray();
+        if (in == out)
+            continue;
+        if (++differing > MaxRowsShown)
+            continue;
+        auto *child = new QTreeWidgetItem(item);
+        child->setText(NameColumn, tr("row %1").arg(row));
+        child->setText(InputColumn, QString::fromLatin1(in));
+        child->setText(OutputColumn, QString::fromLatin1(out));
+        child->setData(NameColumn, KindRole, InfoItem);
+    }
+    if (differing > MaxRowsShown)
+        infoItem(item, tr("%n more differing row(s)", "", differing - MaxRowsShown));
+    if (!differing)
+        infoItem(item, tr("Only whitespace differs"));
+}
@@ -0,0 +1,34 @@
+#ifndef MDLDIFFDIALOG_H
+#define MDLDIFFDIALOG_H
+#include "mdldiff.h"
+#include <QDialog>
+#include <memory>
+
+class QLabel;
+class QTreeWidget;
+class QTreeWidgetItem;
+
+// Shows how a cleaned model differs from its input, node by node. Nodes are
+// aligned by section and name when the dialog opens, the differences inside
+// a node are only worked out once the user expands it.
+class MdlDiffDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    MdlDiffDialog(std::unique_ptr<MdlOutline> input, std::unique_ptr<MdlOutline> output,
+                  const QString& model, QWidget *parent = nullptr);
+
+private:
+    void populate();
+    void expandNode(QTreeWidgetItem *item);
+    void expandProperty(QTreeWidgetItem *item);
+    void onItemExpanded(QTreeWidgetItem *item);
+
+    std::unique_ptr<MdlOutline> m_pInput;
+    std::unique_ptr<MdlOutline> m_pOutput;
+    QTreeWidget *m_pTree;
+    QLabel *m_pSummary;
+};
+
+#endif // MDLDIFFDIALOG_H
@@ -0,0 +1,289 @@
+#include "mdlformat.h"
+#include "dirwalker.h"
+#include <QObject>
+#include <QSet>
+#include <QtEndian>
+#include <cstring>
+
+namespace
+{
+// Position of the model name argument for the keywords that carry one
+int nameTokenIndex(const QByteArray& keyword)
+{
+    if (keyword == "newmodel" || keyword == "setsupermodel" || keyword == "beginmodelgeom" ||
+        keyword == "endmodelgeom" || keyword == "donemodel" || keyword == "parent" || keyword == "animroot")
+        return 1;
+    if (keyword == "node" || keyword == "newanim" || keyword == "doneanim")
+        return 2;
+    return -1;
+}
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Keyword at word, case insensitive and followed by blank or the line end
+bool isKeyword(const char *word, const char *lineEnd, const char *keyword, int length)
+{
+    return lineEnd - word >= length && qstrnicmp(word, keyword, uint(length)) == 0 &&
+           (lineEnd - word == length || isSpace(word[length]));
+}
+
+const char *skipBlanks(const char *pos, const char *lineEnd)
+{
+    while (pos < lineEnd && (*pos == ' ' || *pos == '\t'))
+        ++pos;
+    return pos;
+}
+
+qint64 countAfter(const char *pos, const char *lineEnd)
+{
+    pos = skipBlanks(pos, lineEnd);
+    qint64 count = 0;
+    while (pos < lineEnd && *pos >= '0' && *pos <= '9')
+        count = count * 10 + (*pos++ - '0');
+    return count;
+}
+
+// Anything above this is more likely garbage than a model
+const quint32 MaxNodeCount = 100000;
+
+bool verifyBinary(const QByteArray& data, QString *error)
+{
+    // Binary models start with a zero, then the sizes of the model and raw
+    // data blocks that follow the 12 byte file header. The geometry header
+    // holds two function pointers, the name and the root node offset before
+    // the node count.
+    const int fileHeaderSize = 12;
+    const int nodeCountOffset = fileHeaderSize + 8 + 64 + 4;
+    if (data.size() < nodeCountOffset + 4)
+    {
+        *error = QObject::tr("binary header is incomplete");
+        return false;
+    }
+    const uchar *bytes = reinterpret_cast<const uchar*>(data.constData());
+    const quint64 expected = quint64(fileHeaderSize) + qFromLittleEndian<quint32>(bytes + 4) + qFromLittleEndian<quint32>(bytes + 8);
+    if (expected != quint64(data.size()))
+    {
+        *error = QObject::tr("binary size is %1 bytes, the header expects %2").arg(data.size()).arg(expected);
+        return false;
+    }
+    const quint32 nodeCount = qFromLittleEndian<quint32>(bytes + nodeCountOffset);
+    if (nodeCount == 0 || nodeCount > MaxNodeCount)
+    {
+        *error = QObject::tr("implausible node count %1").arg(nodeCount);
+        return false;
+    }
+    return true;
+}
+
+bool verifyASCII(const QByteArray& data, QString *error)
+{
+    bool newModel = false;
+    bool doneModel = false;
+    quint32 nodes = 0;
+    quint32 endNodes = 0;
+    int lineStart = 0;
+    while (lineStart < data.size())
+    {
+        int lineEnd = data.indexOf('\n', lineStart);
+        if (lineEnd < 0)
+            lineEnd = data.size();
+        int pos = lineStart;
+        while (pos < lineEnd && isSpace(data.at(pos)))
+            ++pos;
+        int keywordEnd = pos;
+        while (keywordEnd < lineEnd && !isSpace(data.at(keywordEnd)))
+            ++keywordEnd;
+        const QByteArray keyword = data.mid(pos, keywordEnd - pos).toLower();
+        if (keyword == "node")
+            ++nodes;
+        else if (keyword == "endnode")
+            ++endNodes;
+        else if (keyword == "newmodel")
+            newModel = true;
+        else if (keyword == "donemodel")
+            doneModel = true;
+        lineStart = lineEnd + 1;
+    }
+    if (!newModel || !doneModel)
+    {
+        *error = QObject::tr("model is not terminated by donemodel");
+        return false;
+    }
+    if (nodes == 0 || nodes > MaxNodeCount || nodes != endNodes)
+    {
+        *error = QObject::tr("%1 nodes but %2 endnode lines").arg(nodes).arg(endNodes);
+        return false;
+    }
+    return true;
+}
+
+QByteArray renamedLine(QByteArray line, const QByteArray& from, const QByteArray& to)
+{
+    int tokenStart[3];
+    int tokenLength[3];
+    int tokens = 0;
+    int pos = 0;
+    while (tokens < 3)
+    {
+        while (pos < line.size() && isSpace(line.at(pos)))
+            ++pos;
+        if (pos >= line.size())
+            break;
+        tokenStart[tokens] = pos;
+        while (pos < line.size() && !isSpace(line.at(pos)))
+            ++pos;
+        tokenLength[tokens] = pos - tokenStart[tokens];
+        ++tokens;
+    }
+    if (tokens < 2)
+        return line;
+    const int index = nameTokenIndex(line.mid(tokenStart[0], tokenLength[0]).toLower());
+    if (index < 0 || index >= tokens)
+        return line;
+    if (line.mid(tokenStart[index], tokenLength[index]).toLower() != from)
+        return line;
+    return line.replace(tokenStart[index], tokenLength[index], to);
+}
+}
+
+QByteArray MdlFormat::renameModel(const QByteArray& data, const QString& oldName, const QString& newName)
+{
+    const QByteArray from = oldName.toLatin1().toLower();
+    const QByteArray to = newName.toLatin1();
+    if (from.isEmpty() || from == to.toLower() || !DirWalker::isASCIIHeader(data.left(256)))
+        return data;
+
+    QByteArray result;
+    result.reserve(data.size() + 64);
+    int lineStart = 0;
+    while (lineStart < data.size())
+    {
+        int lineEnd = data.indexOf('\n', lineStart);
+        lineEnd = lineEnd < 0 ? data.size() : lineEnd + 1;
+        result.append(renamedLine(data.mid(lineStart, lineEnd - lineStart), from, to));
+        lineStart = lineEnd;
+    }
+    return result;
+}
+
+bool MdlFormat::verify(const QByteArray& data, QString *error)
+{
+    if (data.isEmpty())
+    {
+        *error = QObject::tr("file is empty");
+        return false;
+    }
+    if (data.at(0) == '\0')
+        return verifyBinary(data, error);
+    if (!DirWalker::isASCIIHeader(data.left(256)))
+    {
+        *error = QObject::tr("header is neither ASCII nor binary");
+        return false;
+    }
+    return verifyASCII(data, error);
+}
+
+MdlStats MdlFormat::scanStats(const char *data, qint64 size)
+{
+    MdlStats stats;
+    const char *pos = data;
+    const char *end = data + size;
+    bool inGeometry = false;
+    // Meshes render and cast shadows unless told otherwise
+    bool inMesh = false;
+    bool meshRenders = true;
+    bool meshShadows = true;
+    QSet<QByteArray> bitmaps;
+    while (pos < end)
+    {
+        // One memchr per line finds its end, vertex and face rows then fall
+        // through the switch on their first character
+        const char *lineEnd = static_cast<const char*>(memchr(pos, '\n', size_t(end - pos)));
+        if (!lineEnd)
+            lineEnd = end;
+        const char *word = skipBlanks(pos, lineEnd);
+        pos = lineEnd + 1;
+        if (word == lineEnd)
+            continue;
+        switch (*word | 0x20)
+        {
+        case 'b':
+            if (isKeyword(word, lineEnd, "beginmodelgeom", 14))
+            {
+                inGeometry = true;
+            }
+            else if (inGeometry && isKeyword(word, lineEnd, "bitmap", 6))
+            {
+                const char *name = skipBlanks(word + 6, lineEnd);
+                const char *nameEnd = name;
+                while (nameEnd < lineEnd && !isSpace(*nameEnd))
+                    ++nameEnd;
+                const QByteArray bitmap = QByteArray(name, int(nameEnd - name)).toLower();
+                if (!bitmap.isEmpty() && bitmap != "null")
+                    bitmaps.insert(bitmap);
+            }
+            break;
+        case 'e':
+            if (isKeyword(word, lineEnd, "endmodelgeom", 12))
+            {
+                inGeometry = false;
+            }
+            else if (inMesh && isKeyword(word, lineEnd, "endnode", 7))
+            {
+                inMesh = false;
+                stats.renderNodes += meshRenders;
+                stats.shadowNodes += meshShadows;
+            }
+            break;
+        case 'r':
+            if (inMesh && isKeyword(word, lineEnd, "render", 6))
+                meshRenders = countAfter(word + 6, lineEnd) != 0;
+            break;
+        case 's':
+            if (inMesh && isKeyword(word, lineEnd, "shadow", 6))
+                meshShadows = countAfter(word + 6, lineEnd) != 0;
+            break;
+        case 'n':
+            if (isKeyword(word, lineEnd, "newanim", 7))
+            {
+                ++stats.animations;
+            }
+            else if (inGeometry && isKeyword(word, lineEnd, "node", 4))
+            {
+                ++stats.nodes;
+                const char *type = skipBlanks(word + 4, lineEnd);
+                if (isKeyword(type, lineEnd, "trimesh", 7))
+                    ++stats.trimeshes;
+                else if (isKeyword(type, lineEnd, "aabb", 4))
+                    ++stats.aabbs;
+                else if (isKeyword(type, lineEnd, "skin", 4))
+                    ++stats.skins;
+                inMesh = isKeyword(type, lineEnd, "trimesh", 7) || isKeyword(type, lineEnd, "danglymesh", 10) ||
+                         isKeyword(type, lineEnd, "animmesh", 8) || isKeyword(type, lineEnd, "skin", 4);
+                if (inMesh)
+                {
+                    ++stats.meshes;
+                    meshRenders = true;
+                    meshShadows = true;
+                }
+            }
+            break;
+        case 'v':
+            if (inGeometry && isKeyword(word, lineEnd, "verts", 5))
+                stats.verts += countAfter(word + 5, lineEnd);
+            break;
+        case 'f':
+            if (inGeometry && isKeyword(word, lineEnd, "faces", 5))
+                stats.faces += countAfter(word + 5, lineEnd);
+            break;
+        default:
+            break;
+        }
+    }
+    stats.bitmaps = bitmaps.count();
+    stats.valid = true;
+    return stats;
+}
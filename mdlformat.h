@@ -0,0 +1,40 @@
+#ifndef MDLFORMAT_H
+#define MDLFORMAT_H
+#include <QByteArray>
+#include <QString>
+
+// Complexity of an ASCII model, counted over its geometry
+struct MdlStats
+{
+    bool valid = false;
+    int nodes = 0;
+    int trimeshes = 0;
+    int aabbs = 0;
+    int skins = 0;
+    qint64 verts = 0;
+    qint64 faces = 0;
+    int animations = 0;
+    int meshes = 0; // nodes the renderer draws or shadows: trimesh, danglymesh, animmesh, skin
+    int renderNodes = 0;
+    int shadowNodes = 0;
+    int bitmaps = 0; // distinct
+};
+
+namespace MdlFormat
+{
+// Gives ASCII model data a new model name. Only the model's own name and
+// nodes named after it change, bitmaps that happen to share the name keep
+// it. Binary data is returned untouched.
+QByteArray renameModel(const QByteArray& data, const QString& oldName, const QString& newName);
+
+// Quick sanity check of a freshly written model, catches empty and
+// truncated files. The reason for a failure is stored in error.
+bool verify(const QByteArray& data, QString *error);
+
+// Counts nodes, meshes, vertices, faces, animations and what the renderer
+// has to draw of ASCII model data in one pass. Only keyword lines are looked
+// at, vertex and face rows are skipped by their first character.
+MdlStats scanStats(const char *data, qint64 size);
+}
+
+#endif // MDLFORMAT_H
@@ -0,0 +1,107 @@
+#include "mdlstatsscanner.h"
+#include "erfarchive.h"
+#include <QFile>
+#include <QRunnable>
+#include <QStringBuilder>
+
+class MdlStatsTask : public QRunnable
+{
+public:
+    MdlStatsTask(MdlStatsScanner *scanner, int first, int count) :
+        m_pScanner(scanner),
+        m_nFirst(first),
+        m_nCount(count)
+    {
+    }
+
+    void run() override
+    {
+        m_pScanner->scanBatch(m_nFirst, m_nCount);
+        m_pScanner->taskDone();
+    }
+
+private:
+    MdlStatsScanner *m_pScanner;
+    int m_nFirst;
+    int m_nCount;
+};
+
+MdlStatsScanner::MdlStatsScanner(QObject *parent) :
+    QObject(parent)
+{
+}
+
+MdlStatsScanner::~MdlStatsScanner()
+{
+    cancel();
+}
+
+void MdlStatsScanner::start(const QVector<ModelEntry>& entries, const QString& root, const ErfArchive *archive)
+{
+    m_entries = entries;
+    m_sRoot = root;
+    m_pArchive = archive;
+    m_stats.fill(MdlStats(), entries.size());
+    m_timer.start();
+
+    // Small models dominate big folders, batches keep the per task overhead
+    // well below the time spent scanning
+    const int batchSize = 32;
+    m_nPending.ref();
+    for (int first = 0; first < entries.size(); first += batchSize)
+    {
+        m_nPending.ref();
+        m_pool.start(new MdlStatsTask(this, first, qMin(batchSize, entries.size() - first)));
+    }
+    taskDone();
+}
+
+void MdlStatsScanner::cancel()
+{
+    m_nCancelled.storeRelease(1);
+    m_pool.waitForDone();
+}
+
+void MdlStatsScanner::scanBatch(int first, int count)
+{
+    for (int index = first; index < first + count; ++index)
+    {
+        if (m_nCancelled.loadAcquire())
+            return;
+        const ModelEntry &entry = m_entries.at(index);
+        if (!entry.isASCII)
+            continue;
+        if (entry.archiveIndex >= 0 && m_pArchive)
+        {
+            const QByteArray data = m_pArchive->resourceData(entry.archiveIndex);
+            m_stats[index] = MdlFormat::scanStats(data.constData(), data.size());
+            m_nBytes.fetchAndAddRelaxed(data.size());
+            continue;
+        }
+        QFile file(m_sRoot % "/" % entry.relPath);
+        if (!file.open(QIODevice::ReadOnly))
+            continue;
+        // Mapped where possible, the scan then reads straight from the page cache
+        const qint64 size = file.size();
+        if (uchar *mapped = size > 0 ? file.map(0, size) : nullptr)
+        {
+            m_stats[index] = MdlFormat::scanStats(reinterpret_cast<const char*>(mapped), size);
+            file.unmap(mapped);
+        }
+        else
+        {
+            const QByteArray data = file.readAll();
+            m_stats[index] = MdlFormat::scanStats(data.constData(), data.size());
+        }
+        m_nBytes.fetchAndAddRelaxed(size);
+    }
+}
+
+void MdlStatsScanner::taskDone()
+{
+    if (!m_nPending.deref())
+    {
+        m_nElapsedMs = m_timer.elapsed();
+        emit finished();
+    }
+}
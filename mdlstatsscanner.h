@@ -0,0 +1,55 @@
+#ifndef MDLSTATSSCANNER_H
+#define MDLSTATSSCANNER_H
+#include "dirwalker.h"
+#include "mdlformat.h"
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QThreadPool>
+#include <QVector>
+
+class ErfArchive;
+
+// Profiles the ASCII models of a listing on a thread pool, a batch of
+// models per task. Binary models are left out.
+class MdlStatsScanner : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MdlStatsScanner(QObject *parent = nullptr);
+    ~MdlStatsScanner() override;
+
+    // The archive, when given, must stay open until finished() is emitted
+    void start(const QVector<ModelEntry>& entries, const QString& root, const ErfArchive *archive);
+    // Returns once no task touches the inputs any more
+    void cancel();
+
+    // Per entry, invalid for binary or unreadable models
+    QVector<MdlStats> stats() const { return m_stats; }
+    QVector<ModelEntry> entries() const { return m_entries; }
+    qint64 bytesScanned() const { return m_nBytes.loadAcquire(); }
+    qint64 elapsedMs() const { return m_nElapsedMs; }
+
+signals:
+    void finished();
+
+private:
+    friend class MdlStatsTask;
+
+    void scanBatch(int first, int count);
+    void taskDone();
+
+    QVector<ModelEntry> m_entries;
+    QString m_sRoot;
+    const ErfArchive *m_pArchive = nullptr;
+    QVector<MdlStats> m_stats;
+    QAtomicInt m_nPending;
+    QAtomicInt m_nCancelled;
+    QAtomicInteger<qint64> m_nBytes;
+    QElapsedTimer m_timer;
+    qint64 m_nElapsedMs = 0;
+    QThreadPool m_pool;
+};
+
+#endif // MDLSTATSSCANNER_H
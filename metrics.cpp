@@ -0,0 +1,135 @@
+#include "metrics.h"
+#include <QSaveFile>
+#ifdef CLEANMODELS_NETWORK
+#include <QTcpServer>
+#include <QTcpSocket>
+#endif
+
+namespace
+{
+void family(QByteArray& out, const char *name, const char *type, const char *help)
+{
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+void sample(QByteArray& out, const char *name, const QByteArray& labels, double value)
+{
+    out += name;
+    if (!labels.isEmpty())
+        out += '{' + labels + '}';
+    out += ' ';
+    out += QByteArray::number(value, 'g', 12);
+    out += '\n';
+}
+
+void metric(QByteArray& out, const char *name, const char *type, const char *help, double value)
+{
+    family(out, name, type, help);
+    sample(out, name, QByteArray(), value);
+}
+}
+
+QByteArray RunMetrics::exposition() const
+{
+    QByteArray out;
+    metric(out, "cleanmodels_models_done_total", "counter", "Models cleaned or decompiled and moved into place.", modelsDone);
+    metric(out, "cleanmodels_models_failed_total", "counter", "Models that failed to clean, decompile or commit.", modelsFailed);
+    metric(out, "cleanmodels_models_in_flight", "gauge", "Models being processed or verified.", modelsInFlight);
+    metric(out, "cleanmodels_processed_bytes_total", "counter", "Input bytes of the models done.", bytesProcessed);
+    family(out, "cleanmodels_worker_busy_seconds_total", "counter", "Time workers spent on models, by stage.");
+    sample(out, "cleanmodels_worker_busy_seconds_total", "stage=\"clean\"", cleanBusyMs / 1000.0);
+    sample(out, "cleanmodels_worker_busy_seconds_total", "stage=\"decompile\"", decompileBusyMs / 1000.0);
+    family(out, "cleanmodels_worker_slot_busy_seconds_total", "counter", "Time the workers of each slot spent on models.");
+    for (int slot = 0; slot < slotBusyMs.count(); ++slot)
+        sample(out, "cleanmodels_worker_slot_busy_seconds_total", "slot=\"" + QByteArray::number(slot) + '"', slotBusyMs.at(slot) / 1000.0);
+    metric(out, "cleanmodels_workers_busy", "gauge", "Workers with a model to work on.", workersBusy);
+    family(out, "cleanmodels_worker_model_seconds", "gauge", "Time the worker in each slot has spent on its current model.");
+    for (int slot = 0; slot < workerModelMs.count(); ++slot)
+    {
+        if (workerModelMs.at(slot) >= 0)
+            sample(out, "cleanmodels_worker_model_seconds", "slot=\"" + QByteArray::number(slot) + '"', workerModelMs.at(slot) / 1000.0);
+    }
+    metric(out, "cleanmodels_parser_lines_total", "counter", "Worker output lines parsed.", parserLines);
+    metric(out, "cleanmodels_parser_lines_per_second", "gauge", "Worker output lines parsed per second since the last update.", parserLinesPerSecond);
+    metric(out, "cleanmodels_queue_depth", "gauge", "Chunks of models waiting for a worker.", queueDepth);
+    metric(out, "cleanmodels_event_loop_lag_seconds", "gauge", "How late the last metrics update ran on the GUI thread.", eventLoopLagMs / 1000.0);
+    return out;
+}
+
+MetricsExporter::MetricsExporter(QObject *parent)
+    : QObject(parent)
+{
+}
+
+bool MetricsExporter::listen(quint16 port, QString *error)
+{
+#ifdef CLEANMODELS_NETWORK
+    if (!m_pServer)
+    {
+        m_pServer = new QTcpServer(this);
+        connect(m_pServer, &QTcpServer::newConnection, this, &MetricsExporter::onNewConnection);
+    }
+    if (m_pServer->listen(QHostAddress::LocalHost, port))
+        return true;
+    *error = m_pServer->errorString();
+    return false;
+#else
+    Q_UNUSED(port)
+    *error = tr("built without network support");
+    return false;
+#endif
+}
+
+QString MetricsExporter::publish(const QByteArray& text)
+{
+    m_text = text;
+    if (m_sTextfile.isEmpty())
+        return QString();
+    // Collectors must never see half a file
+    QSaveFile file(m_sTextfile);
+    if (!file.open(QIODevice::WriteOnly) || file.write(text) != text.size() || !file.commit())
+        return file.errorString();
+    return QString();
+}
+
+void MetricsExporter::onNewConnection()
+{
+#ifdef CLEANMODELS_NETWORK
+    while (QTcpSocket *socket = m_pServer->nextPendingConnection())
+    {
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+            // Only the request line matters, the answer goes out once the
+            // headers are in
+            QByteArray request = socket->property("request").toByteArray() + socket->readAll();
+            if (!request.contains("\r\n\r\n") && !request.contains("\n\n"))
+            {
+                if (request.size() > 8192)
+                    socket->abort();
+                else
+                    socket->setProperty("request", request);
+                return;
+            }
+            const QList<QByteArray> requestLine = request.left(request.indexOf('\n')).trimmed().split(' ');
+            const bool found = requestLine.count() >= 2 && requestLine.at(0) == "GET"
+                    && (requestLine.at(1) == "/metrics" || requestLine.at(1) == "/");
+            const QByteArray body = found ? m_text : QByteArray("Not found\n");
+            QByteArray response = found ? "HTTP/1.1 200 OK\r\n" : "HTTP/1.1 404 Not Found\r\n";
+            response += "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n";
+            response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+            response += "Connection: close\r\n\r\n";
+            response += body;
+            socket->write(response);
+            socket->disconnectFromHost();
+        });
+    }
+#endif
+}
@@ -0,0 +1,56 @@
+#ifndef METRICS_H
+#define METRICS_H
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+class QTcpServer;
+
+// What a run reports to monitoring. Counters are bumped where the events
+// are handled, gauges are filled in just before the metrics are written.
+struct RunMetrics
+{
+    qint64 modelsDone = 0;
+    qint64 modelsFailed = 0;
+    qint64 bytesProcessed = 0;
+    qint64 parserLines = 0;
+    qint64 cleanBusyMs = 0;
+    qint64 decompileBusyMs = 0;
+
+    int modelsInFlight = 0;
+    int queueDepth = 0; // chunks waiting for a worker
+    int workersBusy = 0;
+    QVector<qint64> slotBusyMs; // per worker slot, over all the workers that held it
+    QVector<qint64> workerModelMs; // per worker slot on its current model, -1 for an empty slot
+    double parserLinesPerSecond = 0;
+    qint64 eventLoopLagMs = 0;
+
+    // Prometheus text exposition format
+    QByteArray exposition() const;
+};
+
+// Hands the metrics to Prometheus, through a textfile for node_exporter's
+// textfile collector and, when built with Qt Network, on a localhost port
+class MetricsExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MetricsExporter(QObject *parent = nullptr);
+
+    void setTextfile(const QString& path) { m_sTextfile = path; }
+    // False with error set when the port is taken or there is no network support
+    bool listen(quint16 port, QString *error);
+    // Rewrites the textfile, returns its error if that failed
+    QString publish(const QByteArray& text);
+
+private:
+    void onNewConnection();
+
+    QString m_sTextfile;
+    QByteArray m_text;
+    QTcpServer *m_pServer = nullptr;
+};
+
+#endif // METRICS_H
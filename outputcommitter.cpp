@@ -0,0 +1,123 @@
+#include "outputcommitter.h"
+#include "erfwriter.h"
+#include "mdlformat.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QMutexLocker>
+#include <QSaveFile>
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <cstdio>
+#endif
+
+class CommitTask : public QRunnable
+{
+public:
+    CommitTask(OutputCommitter *committer, const CommitJob& job) :
+        m_pCommitter(committer),
+        m_job(job)
+    {
+    }
+
+    void run() override
+    {
+        m_pCommitter->process(m_job);
+    }
+
+private:
+    OutputCommitter *m_pCommitter;
+    CommitJob m_job;
+};
+
+OutputCommitter::OutputCommitter(QObject *parent) :
+    QObject(parent)
+{
+}
+
+OutputCommitter::~OutputCommitter()
+{
+    m_pool.waitForDone();
+}
+
+void OutputCommitter::commit(const CommitJob& job)
+{
+    m_pool.start(new CommitTask(this, job));
+}
+
+void OutputCommitter::waitForDone()
+{
+    m_pool.waitForDone();
+}
+
+bool OutputCommitter::replaceFile(const QString& from, const QString& to)
+{
+    // Readers of the target see either the old or the complete new model
+#ifdef Q_OS_WIN
+    return MoveFileExW(reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(from).utf16()),
+                       reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(to).utf16()),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return std::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#endif
+}
+
+void OutputCommitter::process(const CommitJob& job)
+{
+    QFile staged(job.stagedPath);
+    if (!staged.open(QIODevice::ReadOnly))
+    {
+        emit committed(job.jobId, job.modelKey, QStringList(), tr("Could not read ") + job.stagedPath);
+        return;
+    }
+    const QByteArray data = staged.readAll();
+    staged.close();
+    QString error;
+    if (!MdlFormat::verify(data, &error))
+    {
+        staged.remove();
+        emit committed(job.jobId, job.modelKey, QStringList(), QFileInfo(job.stagedPath).fileName() + tr(" failed verification: ") + error);
+        return;
+    }
+
+    // Every identical input gets the result under its own name
+    QStringList copies;
+    for (const CommitCopy &copy : job.copies)
+    {
+        const QByteArray copyData = MdlFormat::renameModel(data, job.resRef, copy.resRef);
+        bool stored;
+        if (job.archive)
+        {
+            QMutexLocker lock(&m_archiveMutex);
+            stored = job.archive->addResource(copy.resRef, job.resType, copyData);
+        }
+        else
+        {
+            QSaveFile copyFile(copy.finalPath);
+            stored = QDir().mkpath(QFileInfo(copy.finalPath).path()) && copyFile.open(QIODevice::WriteOnly) &&
+                     copyFile.write(copyData) == copyData.size() && copyFile.commit();
+        }
+        if (stored)
+            copies.append(copy.modelKey);
+    }
+
+    bool stored;
+    if (job.archive)
+    {
+        QMutexLocker lock(&m_archiveMutex);
+        QString reason;
+        stored = job.archive->addResource(job.resRef, job.resType, data, &reason);
+        staged.remove();
+        if (!stored)
+            error = tr("Could not add ") + job.resRef + tr(" to ") + job.archive->fileName() + ": " + reason;
+    }
+    else
+    {
+        stored = QDir().mkpath(QFileInfo(job.finalPath).path()) && replaceFile(job.stagedPath, job.finalPath);
+        if (!stored)
+            error = tr("Could not move ") + job.stagedPath + tr(" to ") + job.finalPath;
+    }
+    emit committed(job.jobId, job.modelKey, copies, error);
+}
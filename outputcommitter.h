@@ -0,0 +1,60 @@
+#ifndef OUTPUTCOMMITTER_H
+#define OUTPUTCOMMITTER_H
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+
+class ErfWriter;
+
+// An identical input that receives a copy of the committed model
+struct CommitCopy
+{
+    QString modelKey;
+    QString resRef;
+    QString finalPath; // empty when writing into the archive
+};
+
+struct CommitJob
+{
+    int jobId = 0;
+    QString modelKey;
+    QString stagedPath;
+    QString finalPath; // empty when writing into the archive
+    QString resRef;
+    quint16 resType = 0;
+    ErfWriter *archive = nullptr; // must stay open until the job is committed
+    QVector<CommitCopy> copies;
+};
+
+// Moves models written into the staging folder to their final place once
+// they pass MdlFormat::verify(). Work happens on a pool; models headed for
+// an archive are added under a lock since ErfWriter is not thread safe.
+class OutputCommitter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit OutputCommitter(QObject *parent = nullptr);
+    ~OutputCommitter() override;
+
+    void commit(const CommitJob& job);
+    void waitForDone();
+
+    static bool replaceFile(const QString& from, const QString& to);
+
+signals:
+    // error is empty on success, copies lists the identical inputs served
+    void committed(int jobId, const QString& modelKey, const QStringList& copies, const QString& error);
+
+private:
+    friend class CommitTask;
+
+    void process(const CommitJob& job);
+
+    QMutex m_archiveMutex;
+    QThreadPool m_pool;
+};
+
+#endif // OUTPUTCOMMITTER_H
@@ -0,0 +1,231 @@
+#include "prefetcher.h"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QStringBuilder>
+#include <QTemporaryDir>
+#include <cmath>
+
+namespace
+{
+// One chunk to measure the read with
+const int StartDepth = 1;
+const int MaxDepth = 16;
+// Reads below this share of the clean time leave the workers nothing to wait on
+const double CheapRead = 0.1;
+// While nothing is read ahead, one chunk in this many still is, to notice
+// the input slowing down
+const int ProbeEvery = 16;
+
+// Weight of the newest sample in the running averages
+const double SampleWeight = 0.2;
+
+QString ramRoot()
+{
+#ifdef Q_OS_LINUX
+    const QFileInfo shm("/dev/shm");
+    if (shm.isDir() && shm.isWritable())
+        return shm.absoluteFilePath();
+#endif
+    return QDir::tempPath();
+}
+}
+
+class PrefetchTask : public QRunnable
+{
+public:
+    PrefetchTask(Prefetcher *prefetcher, const QString& key, const QString& sourceDir, const QStringList& files,
+                 const QString& folder, const QSharedPointer<QAtomicInt>& cancelled)
+        : m_pPrefetcher(prefetcher), m_sKey(key), m_sSourceDir(sourceDir), m_files(files),
+          m_sFolder(folder), m_cancelled(cancelled) {}
+
+    void run() override
+    {
+        QElapsedTimer timer;
+        timer.start();
+        bool ok = QDir().mkpath(m_sFolder);
+        for (const QString &fileName : qAsConst(m_files))
+        {
+            if (!ok || m_cancelled->loadAcquire())
+                break;
+            ok = QFile::copy(m_sSourceDir % "/" % fileName, m_sFolder % "/" % fileName);
+        }
+        ok = ok && !m_cancelled->loadAcquire();
+        if (!ok)
+            QDir(m_sFolder).removeRecursively();
+        Prefetcher *prefetcher = m_pPrefetcher;
+        const QString key = m_sKey;
+        const qint64 ms = timer.elapsed();
+        const int models = m_files.count();
+        QMetaObject::invokeMethod(prefetcher, [prefetcher, key, ok, ms, models]() {
+            prefetcher->chunkRead(key, ok, ms, models);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    Prefetcher *m_pPrefetcher;
+    QString m_sKey;
+    QString m_sSourceDir;
+    QStringList m_files;
+    QString m_sFolder;
+    QSharedPointer<QAtomicInt> m_cancelled;
+};
+
+Prefetcher::Prefetcher(QObject *parent)
+    : QObject(parent)
+{
+    // A slow share serves a couple of readers no worse than one
+    m_pool.setMaxThreadCount(2);
+}
+
+Prefetcher::~Prefetcher()
+{
+    for (Chunk &chunk : m_chunks)
+        chunk.cancelled->storeRelease(1);
+    m_pool.clear();
+    m_pool.waitForDone();
+    delete m_pRoot;
+}
+
+void Prefetcher::setBudget(qint64 bytes)
+{
+    m_nBudget = qMax<qint64>(0, bytes);
+    // Set for every run, whose input may read at another speed
+    m_readMs = -1;
+    m_cleanMs = -1;
+    m_nUnread = 0;
+}
+
+// Every worker finishes a model per clean time while a reader brings in one
+// per read time, the queue has to cover the difference. Where the workers
+// read about as fast themselves, e.g. from a local disk, copying the models
+// only costs memory and only a probe chunk now and then is read ahead.
+int Prefetcher::depth(int workers) const
+{
+    if (m_readMs < 0 || m_cleanMs <= 0)
+        return StartDepth;
+    const double share = qMax(1, workers) * m_readMs / (m_pool.maxThreadCount() * m_cleanMs);
+    if (share < CheapRead)
+        return m_nUnread >= ProbeEvery ? 1 : 0;
+    const double needed = std::ceil(share);
+    return qBound(1, int(needed) + 1, MaxDepth);
+}
+
+bool Prefetcher::request(int jobId, const QString& key, const QString& sourceDir, const QStringList& files, qint64 bytes)
+{
+    if (m_nBudget <= 0 || m_nUsed + bytes > m_nBudget || m_chunks.contains(key))
+        return false;
+    if (!m_pRoot)
+    {
+        m_pRoot = new QTemporaryDir(ramRoot() % "/cleanmodels-qt-XXXXXX");
+        if (!m_pRoot->isValid())
+        {
+            delete m_pRoot;
+            m_pRoot = nullptr;
+            return false;
+        }
+    }
+    Chunk chunk;
+    chunk.jobId = jobId;
+    chunk.folder = m_pRoot->filePath(QString("prefetch_%1").arg(++m_nSerial));
+    chunk.bytes = bytes;
+    chunk.cancelled = QSharedPointer<QAtomicInt>::create(0);
+    m_chunks.insert(key, chunk);
+    m_nUsed += bytes;
+    m_nUnread = 0;
+    ++m_nPending;
+    m_pool.start(new PrefetchTask(this, key, sourceDir, files, chunk.folder, chunk.cancelled));
+    return true;
+}
+
+QString Prefetcher::take(const QString& key)
+{
+    auto it = m_chunks.find(key);
+    if (it == m_chunks.end())
+    {
+        ++m_nUnread;
+        return QString();
+    }
+    if (it->state == Ready)
+    {
+        it->state = Taken;
+        --m_nPending;
+        m_keys.insert(it->folder, key);
+        return it->folder;
+    }
+    // The run stages its models itself, the read finishes into nothing
+    if (it->state == Reading)
+    {
+        it->state = Dropped;
+        it->cancelled->storeRelease(1);
+        --m_nPending;
+    }
+    return QString();
+}
+
+QString Prefetcher::release(const QString& folder)
+{
+    const QString key = m_keys.take(folder);
+    if (!key.isEmpty())
+        remove(key);
+    return key;
+}
+
+void Prefetcher::dropJob(int jobId)
+{
+    QStringList keys;
+    for (auto it = m_chunks.begin(); it != m_chunks.end(); ++it)
+    {
+        if (it->jobId == jobId)
+            keys.append(it.key());
+    }
+    for (const QString &key : qAsConst(keys))
+    {
+        Chunk &chunk = m_chunks[key];
+        if (chunk.state == Reading)
+        {
+            chunk.state = Dropped;
+            chunk.cancelled->storeRelease(1);
+            --m_nPending;
+        }
+        else if (chunk.state != Dropped)
+        {
+            m_keys.remove(chunk.folder);
+            remove(key);
+        }
+    }
+}
+
+void Prefetcher::noteModelTime(qint64 ms)
+{
+    m_cleanMs = m_cleanMs < 0 ? ms : (1 - SampleWeight) * m_cleanMs + SampleWeight * ms;
+}
+
+void Prefetcher::chunkRead(const QString& key, bool ok, qint64 ms, int models)
+{
+    auto it = m_chunks.find(key);
+    if (it == m_chunks.end())
+        return;
+    if (ok && models > 0)
+    {
+        const double perModel = double(ms) / models;
+        m_readMs = m_readMs < 0 ? perModel : (1 - SampleWeight) * m_readMs + SampleWeight * perModel;
+    }
+    if (it->state == Dropped || !ok)
+    {
+        if (it->state == Reading)
+            --m_nPending;
+        remove(key);
+        return;
+    }
+    it->state = Ready;
+}
+
+void Prefetcher::remove(const QString& key)
+{
+    const Chunk chunk = m_chunks.take(key);
+    m_nUsed -= chunk.bytes;
+    QDir(chunk.folder).removeRecursively();
+}
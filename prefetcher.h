@@ -0,0 +1,81 @@
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+#include <QAtomicInt>
+#include <QHash>
+#include <QObject>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QThreadPool>
+
+class QTemporaryDir;
+
+// Reads the models of upcoming chunks into a RAM-backed folder ahead of their
+// run, so workers do not wait on a slow input folder between models. Chunks
+// are read on a private thread pool within a memory budget. How many are
+// read ahead follows the time a model takes to read against the time it
+// takes to clean. Once reading is cheap, only an occasional probe chunk is
+// read to keep the measurement current.
+class Prefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit Prefetcher(QObject *parent = nullptr);
+    ~Prefetcher() override;
+
+    // Zero turns reading ahead off
+    void setBudget(qint64 bytes);
+    qint64 budget() const { return m_nBudget; }
+    qint64 used() const { return m_nUsed; }
+
+    // Chunks to keep read ahead for that many workers, zero between probes
+    // when the input reads fast enough without
+    int depth(int workers) const;
+    int pending() const { return m_nPending; }
+
+    // Reads files of sourceDir for the chunk known by key, false when they
+    // do not fit the budget
+    bool request(int jobId, const QString& key, const QString& sourceDir, const QStringList& files, qint64 bytes);
+    bool contains(const QString& key) const { return m_chunks.contains(key); }
+    // The folder holding the chunk once it is read completely, the chunk
+    // then belongs to its run until released. A chunk still being read is
+    // given up and empty returned. Called for every chunk that could have
+    // been read ahead.
+    QString take(const QString& key);
+    // Frees a folder handed out by take, returns the key it was read for or
+    // an empty string when the folder is not one of ours
+    QString release(const QString& folder);
+    void dropJob(int jobId);
+    void noteModelTime(qint64 ms);
+
+private:
+    friend class PrefetchTask;
+
+    enum State { Reading, Ready, Taken, Dropped };
+    struct Chunk
+    {
+        int jobId = 0;
+        QString folder;
+        qint64 bytes = 0;
+        State state = Reading;
+        QSharedPointer<QAtomicInt> cancelled;
+    };
+
+    void chunkRead(const QString& key, bool ok, qint64 ms, int models);
+    // Only once the chunk's read is over
+    void remove(const QString& key);
+
+    QTemporaryDir *m_pRoot = nullptr;
+    QHash<QString, Chunk> m_chunks; // by key
+    QHash<QString, QString> m_keys; // by folder of taken chunks
+    qint64 m_nBudget = 0;
+    qint64 m_nUsed = 0;
+    int m_nPending = 0; // reading or ready
+    int m_nSerial = 0;
+    int m_nUnread = 0; // chunks started since the last one read ahead
+    double m_readMs = -1; // per model, running averages
+    double m_cleanMs = -1;
+    QThreadPool m_pool;
+};
+
+#endif // PREFETCHER_H
@@ -0,0 +1,72 @@
+#ifndef REMOTEPROTOCOL_H
+#define REMOTEPROTOCOL_H
+#include <QByteArray>
+#include <QDataStream>
+#include <QtEndian>
+
+// cleanmodels-agent runs with ListenOption on the hosts that clean models.
+// On the front end's side it is started with RemoteOption and the agent's
+// host:port ahead of the usual CLI arguments and stands in for the CLI: it
+// ships the options and the models of the chunk to the agent, prints the
+// CLI's output as it arrives and writes the cleaned models where the CLI
+// would have. It exits with LostExitCode when the agent cannot be reached or
+// goes away, the models it has not reported are then still to be done.
+// Both take the shared token from TokenVariable. A connection opens with a
+// Hello of at most MaxHelloFrame bytes, the agent reads nothing further
+// from a peer without its token.
+//
+// Every message is a frame, a big endian quint32 payload size followed by a
+// QDataStream payload starting with the message type as quint8.
+//   Hello     QByteArray token
+//   Task      QStringList cli arguments, QString options, quint32 count,
+//             count times QString file name and QByteArray contents
+//   Started   QString input folder, QString output folder on the agent
+//   Line      quint8 channel (0 stdout, 1 stderr), QByteArray line
+//   File      QString path below the output folder, QByteArray contents,
+//             sent ahead of the line reporting it written
+//   Finished  qint32 exit code, bool crashed
+//   Alive     nothing, sent every HeartbeatMs while the CLI runs
+namespace RemoteProtocol
+{
+const char ListenOption[] = "--listen";
+const char RemoteOption[] = "--remote";
+const char TokenVariable[] = "CLEANMODELS_AGENT_TOKEN";
+const quint16 DefaultPort = 7455;
+const int LostExitCode = 75;
+const int HeartbeatMs = 5000;
+const int TimeoutMs = 30000;
+const quint32 MaxFrame = 1u << 30;
+const quint32 MaxHelloFrame = 4096;
+const QDataStream::Version StreamVersion = QDataStream::Qt_5_6;
+
+enum Message : quint8 { Task = 1, Started, Line, File, Finished, Alive, Hello };
+
+inline QByteArray frame(const QByteArray& payload)
+{
+    QByteArray framed(4, Qt::Uninitialized);
+    qToBigEndian<quint32>(quint32(payload.size()), framed.data());
+    return framed + payload;
+}
+
+// Takes the next complete frame off the front of buffer, false while it is
+// still arriving. A size above maxSize leaves error set.
+inline bool takeFrame(QByteArray& buffer, QByteArray *payload, bool *error, quint32 maxSize = MaxFrame)
+{
+    *error = false;
+    if (buffer.size() < 4)
+        return false;
+    const quint32 size = qFromBigEndian<quint32>(buffer.constData());
+    if (size > maxSize)
+    {
+        *error = true;
+        return false;
+    }
+    if (quint32(buffer.size()) - 4 < size)
+        return false;
+    *payload = buffer.mid(4, int(size));
+    buffer.remove(0, 4 + int(size));
+    return true;
+}
+}
+
+#endif // REMOTEPROTOCOL_H
@@ -0,0 +1,171 @@
+#include "resultsbrowser.h"
+#include "resultsproxy.h"
+#include <QBoxLayout>
+#include <QCheckBox>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QSpinBox>
+#include <QSplitter>
+#include <QStackedWidget>
+#include <QTableView>
+#include <QTableWidget>
+#include <QToolButton>
+
+ResultsBrowser::ResultsBrowser(QTableWidget *table)
+    : QWidget(table->parentWidget()), m_pTable(table)
+{
+    if (auto *splitter = qobject_cast<QSplitter*>(table->parentWidget()))
+        splitter->insertWidget(splitter->indexOf(table), this);
+    setSizePolicy(table->sizePolicy());
+
+    m_pNameEdit = new QLineEdit(this);
+    m_pNameEdit->setPlaceholderText(tr("Name contains"));
+    m_pNameEdit->setClearButtonEnabled(true);
+    m_pMinSizeSpin = new QSpinBox(this);
+    m_pMaxSizeSpin = new QSpinBox(this);
+    for (QSpinBox *sizeSpin : {m_pMinSizeSpin, m_pMaxSizeSpin})
+    {
+        sizeSpin->setRange(0, 2097151);
+        sizeSpin->setSingleStep(64);
+        sizeSpin->setSuffix(" KB");
+        sizeSpin->setSpecialValueText(tr("Any"));
+    }
+    m_pMinSizeSpin->setToolTip(tr("Smallest model size shown"));
+    m_pMaxSizeSpin->setToolTip(tr("Largest model size shown"));
+    m_pFailedCheck = new QCheckBox(tr("Failed only"), this);
+    m_pBinaryCheck = new QCheckBox(tr("Binary only"), this);
+    auto *resetButton = new QToolButton(this);
+    resetButton->setText(tr("Show All"));
+    resetButton->setToolTip(tr("Clear the filters and show the models in the order they were listed"));
+    m_pCountLabel = new QLabel(this);
+
+    auto *bar = new QHBoxLayout();
+    bar->setContentsMargins(0, 0, 0, 0);
+    bar->addWidget(m_pNameEdit, 1);
+    bar->addWidget(new QLabel(tr("Size:"), this));
+    bar->addWidget(m_pMinSizeSpin);
+    bar->addWidget(new QLabel(tr("to"), this));
+    bar->addWidget(m_pMaxSizeSpin);
+    bar->addWidget(m_pFailedCheck);
+    bar->addWidget(m_pBinaryCheck);
+    bar->addWidget(resetButton);
+    bar->addWidget(m_pCountLabel);
+
+    m_pProxy = new ResultsProxyModel(this);
+    m_pProxy->setSourceModel(table->model());
+    m_pView = new QTableView(this);
+    m_pView->setModel(m_pProxy);
+    m_pView->setAlternatingRowColors(true);
+    m_pView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_pView->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_pView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_pView->verticalHeader()->setDefaultSectionSize(20);
+    m_pView->verticalHeader()->setVisible(false);
+    m_pView->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    m_pView->horizontalHeader()->setSortIndicator(-1, Qt::AscendingOrder);
+    m_pView->setSortingEnabled(true);
+    m_pView->setContextMenuPolicy(Qt::CustomContextMenu);
+    table->setContextMenuPolicy(Qt::CustomContextMenu);
+
+    m_pStack = new QStackedWidget(this);
+    m_pStack->addWidget(table);
+    m_pStack->addWidget(m_pView);
+    auto *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->setSpacing(2);
+    layout->addLayout(bar);
+    layout->addWidget(m_pStack, 1);
+
+    connect(m_pNameEdit, &QLineEdit::textChanged, this, &ResultsBrowser::applyFilter);
+    connect(m_pMinSizeSpin, static_cast<void(QSpinBox::*)(int)>(&QSpinBox::valueChanged), this, &ResultsBrowser::applyFilter);
+    connect(m_pMaxSizeSpin, static_cast<void(QSpinBox::*)(int)>(&QSpinBox::valueChanged), this, &ResultsBrowser::applyFilter);
+    connect(m_pFailedCheck, &QCheckBox::toggled, this, &ResultsBrowser::applyFilter);
+    connect(m_pBinaryCheck, &QCheckBox::toggled, this, &ResultsBrowser::applyFilter);
+    connect(resetButton, &QToolButton::clicked, this, &ResultsBrowser::reset);
+    connect(m_pProxy, &QAbstractItemModel::modelReset, this, &ResultsBrowser::updateCount);
+    connect(m_pProxy, &QAbstractItemModel::rowsInserted, this, &ResultsBrowser::updateCount);
+    connect(m_pProxy, &QAbstractItemModel::rowsRemoved, this, &ResultsBrowser::updateCount);
+
+    // The table sorts nothing itself, its header sorts the view instead
+    connect(table->horizontalHeader(), &QHeaderView::sectionClicked, this, &ResultsBrowser::sortBy);
+    connect(m_pView->selectionModel(), &QItemSelectionModel::currentRowChanged, this, [this](const QModelIndex& current) {
+        const QModelIndex source = m_pProxy->mapToSource(current);
+        if (source.isValid())
+            m_pTable->selectRow(source.row());
+    });
+    connect(table, &QTableWidget::cellDoubleClicked, this, [this](int row) {
+        emit rowDoubleClicked(row);
+    });
+    connect(m_pView, &QTableView::doubleClicked, this, [this](const QModelIndex& index) {
+        const QModelIndex source = m_pProxy->mapToSource(index);
+        if (source.isValid())
+            emit rowDoubleClicked(source.row());
+    });
+    // Positions are the viewport's, below the header
+    connect(table, &QWidget::customContextMenuRequested, this, [this](const QPoint& pos) {
+        const QModelIndex index = m_pTable->indexAt(pos);
+        if (index.isValid())
+            emit contextMenuRequested(index.row(), m_pTable->viewport()->mapToGlobal(pos));
+    });
+    connect(m_pView, &QWidget::customContextMenuRequested, this, [this](const QPoint& pos) {
+        const QModelIndex source = m_pProxy->mapToSource(m_pView->indexAt(pos));
+        if (!source.isValid())
+            return;
+        m_pView->setCurrentIndex(m_pView->indexAt(pos));
+        emit contextMenuRequested(source.row(), m_pView->viewport()->mapToGlobal(pos));
+    });
+}
+
+void ResultsBrowser::applyFilter()
+{
+    ResultsFilter filter;
+    filter.name = m_pNameEdit->text().trimmed();
+    filter.minSize = qint64(m_pMinSizeSpin->value()) * 1024;
+    filter.maxSize = qint64(m_pMaxSizeSpin->value()) * 1024;
+    filter.failedOnly = m_pFailedCheck->isChecked();
+    filter.binaryOnly = m_pBinaryCheck->isChecked();
+    m_pProxy->setFilter(filter);
+    showView(m_pProxy->isActive());
+}
+
+void ResultsBrowser::sortBy(int column)
+{
+    showView(true);
+    m_pView->sortByColumn(column, Qt::AscendingOrder);
+}
+
+void ResultsBrowser::reset()
+{
+    for (QWidget *widget : std::initializer_list<QWidget*>{m_pNameEdit, m_pMinSizeSpin, m_pMaxSizeSpin, m_pFailedCheck, m_pBinaryCheck})
+        widget->blockSignals(true);
+    m_pNameEdit->clear();
+    m_pMinSizeSpin->setValue(0);
+    m_pMaxSizeSpin->setValue(0);
+    m_pFailedCheck->setChecked(false);
+    m_pBinaryCheck->setChecked(false);
+    for (QWidget *widget : std::initializer_list<QWidget*>{m_pNameEdit, m_pMinSizeSpin, m_pMaxSizeSpin, m_pFailedCheck, m_pBinaryCheck})
+        widget->blockSignals(false);
+    m_pView->horizontalHeader()->setSortIndicator(-1, Qt::AscendingOrder);
+    m_pProxy->sort(-1);
+    applyFilter();
+}
+
+void ResultsBrowser::showView(bool show)
+{
+    if (show && m_pStack->currentWidget() != m_pView)
+    {
+        for (int column = 0; column < m_pTable->columnCount(); ++column)
+            m_pView->setColumnWidth(column, m_pTable->columnWidth(column));
+    }
+    m_pStack->setCurrentWidget(show ? static_cast<QWidget*>(m_pView) : m_pTable);
+    updateCount();
+}
+
+void ResultsBrowser::updateCount()
+{
+    if (m_pProxy->isActive())
+        m_pCountLabel->setText(tr("%1 of %2").arg(m_pProxy->rowCount()).arg(m_pTable->rowCount()));
+    else
+        m_pCountLabel->clear();
+}
@@ -0,0 +1,50 @@
+#ifndef RESULTSBROWSER_H
+#define RESULTSBROWSER_H
+#include <QWidget>
+
+class QCheckBox;
+class QLabel;
+class QLineEdit;
+class QSpinBox;
+class QStackedWidget;
+class QTableView;
+class QTableWidget;
+class ResultsProxyModel;
+
+// Quick filters above a results table. Sorting or filtering swaps the table
+// for a view through a ResultsProxyModel, the table itself never reorders
+// its rows, so a run keeps updating it by row at no cost. The selection in
+// the view goes to the table's rows, clicks and context menus of either are
+// reported by table row.
+class ResultsBrowser : public QWidget
+{
+    Q_OBJECT
+
+public:
+    // Takes the table's place in its splitter
+    explicit ResultsBrowser(QTableWidget *table);
+
+signals:
+    void rowDoubleClicked(int row);
+    void contextMenuRequested(int row, const QPoint& globalPos);
+
+private:
+    void applyFilter();
+    void sortBy(int column);
+    void reset();
+    void showView(bool show);
+    void updateCount();
+
+    QTableWidget *m_pTable;
+    ResultsProxyModel *m_pProxy;
+    QTableView *m_pView;
+    QStackedWidget *m_pStack;
+    QCheckBox *m_pFailedCheck;
+    QCheckBox *m_pBinaryCheck;
+    QSpinBox *m_pMinSizeSpin;
+    QSpinBox *m_pMaxSizeSpin;
+    QLineEdit *m_pNameEdit;
+    QLabel *m_pCountLabel;
+};
+
+#endif // RESULTSBROWSER_H
@@ -0,0 +1,346 @@
+#include "resultsproxy.h"
+#include <QTime>
+#include <QTimer>
+#include <algorithm>
+#include <numeric>
+
+ResultsProxyModel::ResultsProxyModel(QObject *parent)
+    : QAbstractProxyModel(parent)
+{
+}
+
+void ResultsProxyModel::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    beginResetModel();
+    if (this->sourceModel())
+        this->sourceModel()->disconnect(this);
+    QAbstractProxyModel::setSourceModel(sourceModel);
+    m_columns.clear();
+    m_shown.clear();
+    m_bStale = true;
+    if (sourceModel)
+    {
+        connect(sourceModel, &QAbstractItemModel::dataChanged, this, &ResultsProxyModel::onSourceDataChanged);
+        connect(sourceModel, &QAbstractItemModel::rowsInserted, this, &ResultsProxyModel::invalidate);
+        connect(sourceModel, &QAbstractItemModel::rowsRemoved, this, &ResultsProxyModel::invalidate);
+        connect(sourceModel, &QAbstractItemModel::rowsMoved, this, &ResultsProxyModel::invalidate);
+        connect(sourceModel, &QAbstractItemModel::columnsInserted, this, &ResultsProxyModel::invalidate);
+        connect(sourceModel, &QAbstractItemModel::columnsRemoved, this, &ResultsProxyModel::invalidate);
+        connect(sourceModel, &QAbstractItemModel::layoutChanged, this, &ResultsProxyModel::invalidate);
+        connect(sourceModel, &QAbstractItemModel::modelReset, this, &ResultsProxyModel::invalidate);
+        connect(sourceModel, &QAbstractItemModel::headerDataChanged, this, &QAbstractItemModel::headerDataChanged);
+    }
+    endResetModel();
+}
+
+QModelIndex ResultsProxyModel::index(int row, int column, const QModelIndex& parent) const
+{
+    if (parent.isValid() || row < 0 || row >= m_shown.count() || column < 0 || column >= columnCount())
+        return QModelIndex();
+    return createIndex(row, column);
+}
+
+QModelIndex ResultsProxyModel::parent(const QModelIndex&) const
+{
+    return QModelIndex();
+}
+
+int ResultsProxyModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : m_shown.count();
+}
+
+int ResultsProxyModel::columnCount(const QModelIndex& parent) const
+{
+    return parent.isValid() || !sourceModel() ? 0 : sourceModel()->columnCount();
+}
+
+QModelIndex ResultsProxyModel::mapToSource(const QModelIndex& proxyIndex) const
+{
+    if (!proxyIndex.isValid() || !sourceModel() || proxyIndex.row() >= m_shown.count())
+        return QModelIndex();
+    return sourceModel()->index(m_shown.at(proxyIndex.row()), proxyIndex.column());
+}
+
+QModelIndex ResultsProxyModel::mapFromSource(const QModelIndex& sourceIndex) const
+{
+    if (!sourceIndex.isValid() || m_bStale)
+        return QModelIndex();
+    const int position = shownPosition(sourceIndex.row());
+    return position < 0 ? QModelIndex() : index(position, sourceIndex.column());
+}
+
+QVariant ResultsProxyModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Vertical)
+        return role == Qt::DisplayRole ? QVariant(section + 1) : QVariant();
+    return sourceModel() ? sourceModel()->headerData(section, orientation, role) : QVariant();
+}
+
+// A column sorted by for the first time is indexed here, after that it is
+// kept sorted as its cells change
+void ResultsProxyModel::sort(int column, Qt::SortOrder order)
+{
+    beginResetModel();
+    m_nSortColumn = column;
+    m_sortOrder = order;
+    if (m_bStale)
+    {
+        if (isActive())
+            rebuild();
+    }
+    else
+    {
+        if (column >= 0 && !m_columns.contains(column))
+            buildColumn(column);
+        fillShown();
+    }
+    endResetModel();
+}
+
+void ResultsProxyModel::setFilter(const ResultsFilter& filter)
+{
+    beginResetModel();
+    m_filter = filter;
+    if (!m_bStale)
+        fillShown();
+    else if (isActive())
+        rebuild();
+    endResetModel();
+}
+
+void ResultsProxyModel::onSourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight)
+{
+    if (m_bStale)
+        return;
+    // Nobody looks while the table shows itself, it is all read again later
+    if (!isActive())
+    {
+        m_bStale = true;
+        return;
+    }
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row)
+        updateRow(row, topLeft.column(), bottomRight.column());
+}
+
+// Rows came or went, the cells filled in right after them are read in one go
+void ResultsProxyModel::invalidate()
+{
+    beginResetModel();
+    m_shown.clear();
+    m_bStale = true;
+    endResetModel();
+    if (!isActive() || m_bRebuildQueued)
+        return;
+    m_bRebuildQueued = true;
+    QTimer::singleShot(0, this, [this]() {
+        m_bRebuildQueued = false;
+        if (!m_bStale || !isActive())
+            return;
+        beginResetModel();
+        rebuild();
+        endResetModel();
+    });
+}
+
+void ResultsProxyModel::rebuild()
+{
+    const int count = sourceModel() ? sourceModel()->rowCount() : 0;
+    m_rows.resize(count);
+    for (int row = 0; row < count; ++row)
+        m_rows[row] = rowOf(row);
+    const QList<int> columns = m_columns.keys();
+    for (int column : columns)
+        buildColumn(column);
+    if (m_nSortColumn >= 0 && !m_columns.contains(m_nSortColumn))
+        buildColumn(m_nSortColumn);
+    m_bStale = false;
+    fillShown();
+}
+
+void ResultsProxyModel::fillShown()
+{
+    m_shown.clear();
+    if (m_bStale)
+        return;
+    if (m_nSortColumn < 0)
+    {
+        for (int row = 0; row < m_rows.count(); ++row)
+        {
+            if (accepts(row))
+                m_shown.append(row);
+        }
+        return;
+    }
+    const QVector<int> &order = m_columns[m_nSortColumn].order;
+    if (m_sortOrder == Qt::AscendingOrder)
+    {
+        for (int row : order)
+        {
+            if (accepts(row))
+                m_shown.append(row);
+        }
+    }
+    else
+    {
+        for (auto it = order.crbegin(); it != order.crend(); ++it)
+        {
+            if (accepts(*it))
+                m_shown.append(*it);
+        }
+    }
+}
+
+void ResultsProxyModel::updateRow(int row, int firstColumn, int lastColumn)
+{
+    if (row < 0 || row >= m_rows.count())
+        return;
+    const int oldPosition = shownPosition(row);
+    for (int column = firstColumn; column <= lastColumn; ++column)
+    {
+        auto found = m_columns.find(column);
+        if (found == m_columns.end())
+            continue;
+        ColumnIndex &index = *found;
+        auto less = [this, &index](int a, int b) { return keyLess(index, a, b); };
+        auto at = std::lower_bound(index.order.begin(), index.order.end(), row, less);
+        if (at != index.order.end() && *at == row)
+            index.order.erase(at);
+        index.keys[row] = keyOf(row, column);
+        index.order.insert(std::lower_bound(index.order.begin(), index.order.end(), row, less), row);
+    }
+    if (firstColumn <= 2)
+        m_rows[row] = rowOf(row);
+
+    const bool show = accepts(row);
+    auto before = [this](int a, int b) { return shownBefore(a, b); };
+    if (oldPosition >= 0)
+    {
+        m_shown.remove(oldPosition);
+        const int newPosition = show ? int(std::lower_bound(m_shown.begin(), m_shown.end(), row, before) - m_shown.begin()) : -1;
+        m_shown.insert(oldPosition, row);
+        if (newPosition == oldPosition)
+        {
+            emit dataChanged(index(oldPosition, firstColumn), index(oldPosition, lastColumn));
+        }
+        else if (newPosition >= 0)
+        {
+            // Moved rather than removed and added, so a selected row stays selected
+            beginMoveRows(QModelIndex(), oldPosition, oldPosition, QModelIndex(), newPosition > oldPosition ? newPosition + 1 : newPosition);
+            m_shown.remove(oldPosition);
+            m_shown.insert(newPosition, row);
+            endMoveRows();
+        }
+        else
+        {
+            beginRemoveRows(QModelIndex(), oldPosition, oldPosition);
+            m_shown.remove(oldPosition);
+            endRemoveRows();
+        }
+    }
+    else if (show)
+    {
+        const int newPosition = int(std::lower_bound(m_shown.begin(), m_shown.end(), row, before) - m_shown.begin());
+        beginInsertRows(QModelIndex(), newPosition, newPosition);
+        m_shown.insert(newPosition, row);
+        endInsertRows();
+    }
+}
+
+ResultsProxyModel::SortKey ResultsProxyModel::keyOf(int row, int column) const
+{
+    SortKey key;
+    const QVariant value = sourceModel()->index(row, column).data();
+    const QString text = value.toString();
+    if (text.isEmpty())
+        return key;
+    bool ok = false;
+    const double number = value.toDouble(&ok);
+    if (ok)
+    {
+        key.kind = SortKey::Number;
+        key.number = number;
+        return key;
+    }
+    // Times as the table shows them
+    const QTime time = QTime::fromString(text, "mm:ss.zzz");
+    if (time.isValid())
+    {
+        key.kind = SortKey::Number;
+        key.number = time.msecsSinceStartOfDay();
+        return key;
+    }
+    key.kind = SortKey::Text;
+    key.text = text;
+    return key;
+}
+
+ResultsProxyModel::Row ResultsProxyModel::rowOf(int row) const
+{
+    Row result;
+    const QModelIndex fileIndex = sourceModel()->index(row, 0);
+    result.name = fileIndex.data().toString();
+    result.binary = fileIndex.data(BinaryRole).toBool();
+    result.size = sourceModel()->index(row, 1).data().toLongLong();
+    result.failed = sourceModel()->index(row, 2).data(FailedRole).toBool();
+    return result;
+}
+
+bool ResultsProxyModel::accepts(int row) const
+{
+    const Row &entry = m_rows.at(row);
+    if (m_filter.failedOnly && !entry.failed)
+        return false;
+    if (m_filter.binaryOnly && !entry.binary)
+        return false;
+    if (m_filter.minSize > 0 && entry.size < m_filter.minSize)
+        return false;
+    if (m_filter.maxSize > 0 && entry.size > m_filter.maxSize)
+        return false;
+    return m_filter.name.isEmpty() || entry.name.contains(m_filter.name, Qt::CaseInsensitive);
+}
+
+// Numbers before text before empty cells, equal keys by row
+bool ResultsProxyModel::keyLess(const ColumnIndex& index, int a, int b) const
+{
+    const SortKey &keyA = index.keys.at(a);
+    const SortKey &keyB = index.keys.at(b);
+    if (keyA.kind != keyB.kind)
+        return keyA.kind < keyB.kind;
+    if (keyA.kind == SortKey::Number && keyA.number != keyB.number)
+        return keyA.number < keyB.number;
+    if (keyA.kind == SortKey::Text)
+    {
+        const int order = keyA.text.compare(keyB.text, Qt::CaseInsensitive);
+        if (order != 0)
+            return order < 0;
+    }
+    return a < b;
+}
+
+bool ResultsProxyModel::shownBefore(int a, int b) const
+{
+    if (m_nSortColumn < 0)
+        return a < b;
+    const ColumnIndex &index = *m_columns.constFind(m_nSortColumn);
+    return m_sortOrder == Qt::AscendingOrder ? keyLess(index, a, b) : keyLess(index, b, a);
+}
+
+int ResultsProxyModel::shownPosition(int row) const
+{
+    auto before = [this](int a, int b) { return shownBefore(a, b); };
+    auto at = std::lower_bound(m_shown.constBegin(), m_shown.constEnd(), row, before);
+    return at != m_shown.constEnd() && *at == row ? int(at - m_shown.constBegin()) : -1;
+}
+
+void ResultsProxyModel::buildColumn(int column)
+{
+    ColumnIndex &index = m_columns[column];
+    const int count = m_rows.count();
+    index.keys.resize(count);
+    for (int row = 0; row < count; ++row)
+        index.keys[row] = keyOf(row, column);
+    index.order.resize(count);
+    std::iota(index.order.begin(), index.order.end(), 0);
+    std::sort(index.order.begin(), index.order.end(), [this, &index](int a, int b) { return keyLess(index, a, b); });
+}
@@ -0,0 +1,98 @@
+#ifndef RESULTSPROXY_H
+#define RESULTSPROXY_H
+#include <QAbstractProxyModel>
+#include <QHash>
+#include <QVector>
+
+// What the quick filters let through, an empty filter passes every row
+struct ResultsFilter
+{
+    bool failedOnly = false;
+    bool binaryOnly = false;
+    qint64 minSize = 0;
+    qint64 maxSize = 0; // no upper bound when zero
+    QString name; // part of the file name, any case
+
+    bool isEmpty() const { return !failedOnly && !binaryOnly && minSize <= 0 && maxSize <= 0 && name.isEmpty(); }
+};
+
+// Sorted and filtered rows of a results table. The table keeps its rows in
+// place and the proxy keeps a compact copy of what the filters look at,
+// plus a sorted permutation of the rows for every column sorted by so far.
+// A changed cell moves only its own row in those, so the order holds up
+// while a run keeps updating the table. Whole rows added or removed rebuild
+// everything once the event loop gets to it.
+class ResultsProxyModel : public QAbstractProxyModel
+{
+    Q_OBJECT
+
+public:
+    enum Role
+    {
+        FailedRole = Qt::UserRole + 1, // on the status item of a failed model
+        BinaryRole // on the file item of a binary model
+    };
+
+    explicit ResultsProxyModel(QObject *parent = nullptr);
+
+    void setSourceModel(QAbstractItemModel *sourceModel) override;
+    QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex& child) const override;
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QModelIndex mapToSource(const QModelIndex& proxyIndex) const override;
+    QModelIndex mapFromSource(const QModelIndex& sourceIndex) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+    void setFilter(const ResultsFilter& filter);
+    const ResultsFilter& filter() const { return m_filter; }
+    int sortColumn() const { return m_nSortColumn; }
+    // Neither sorted nor filtered, the table shows itself as it is
+    bool isActive() const { return m_nSortColumn >= 0 || !m_filter.isEmpty(); }
+
+private:
+    struct SortKey
+    {
+        enum Kind { Number, Text, Empty };
+        Kind kind = Empty;
+        double number = 0;
+        QString text;
+    };
+    struct ColumnIndex
+    {
+        QVector<SortKey> keys; // by source row
+        QVector<int> order; // source rows by ascending key
+    };
+    struct Row
+    {
+        qint64 size = 0;
+        bool failed = false;
+        bool binary = false;
+        QString name;
+    };
+
+    void onSourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+    void invalidate();
+    void rebuild();
+    void fillShown();
+    void updateRow(int row, int firstColumn, int lastColumn);
+    SortKey keyOf(int row, int column) const;
+    Row rowOf(int row) const;
+    bool accepts(int row) const;
+    bool keyLess(const ColumnIndex& index, int a, int b) const;
+    bool shownBefore(int a, int b) const;
+    int shownPosition(int row) const;
+    void buildColumn(int column);
+
+    ResultsFilter m_filter;
+    int m_nSortColumn = -1;
+    Qt::SortOrder m_sortOrder = Qt::AscendingOrder;
+    QVector<Row> m_rows; // by source row
+    QHash<int, ColumnIndex> m_columns; // the ones sorted by so far
+    QVector<int> m_shown; // source rows in the order shown
+    bool m_bStale = true;
+    bool m_bRebuildQueued = false;
+};
+
+#endif // RESULTSPROXY_H
@@ -0,0 +1,124 @@
+#include "workerprotocol.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QRegularExpression>
+#include <QStringBuilder>
+#include <QTextStream>
+#include <QThread>
+
+// Stand-in for cleanmodels-cli that copies models unchanged and reports them
+// the way the CLI does, with and without --serve. Lets the front end and the
+// worker protocol be exercised without Prolog. CLEANMODELS_STUB_DELAY_MS
+// makes every model take that long. Each model reports up to three of the
+// fix lines below, picked by its name, so Run > Fix Breakdown has something
+// to sort.
+
+namespace
+{
+QString option(const QString& optionsText, const QString& key)
+{
+    QRegularExpression rx(":-asserta\\(" % QRegularExpression::escape(key) % "\\('(.*)'\\)\\)\\.");
+    QRegularExpressionMatch match = rx.match(optionsText);
+    return match.hasMatch() ? match.captured(1) : QString();
+}
+
+// One for most kinds of FixCatalog
+const char *const fixLines[] = {
+    "Snapped 12 tverts to the texture grid",
+    "Snapped 8 vertices to the grid",
+    "Repivoted node %1",
+    "Split mesh %1 into 2 meshes",
+    "Merged 3 meshes of %1 by bitmap",
+    "Smoothed 24 faces of %1",
+    "Turned off shadows on %1",
+    "Fixed 2 overhangs in the walkmesh",
+    "Mapped 6 aabb faces of %1",
+    "Raised tile %1 by 1",
+    "Culled invisible mesh %1",
+};
+
+void cleanModel(QTextStream& out, const QString& path, const QString& outDir, int delayMs)
+{
+    out << "Attempting to read " << path << "\n";
+    out.flush();
+    QFile in(path);
+    if (!in.open(QIODevice::ReadOnly))
+    {
+        out << "*** Cannot read " << path << "\n";
+        out.flush();
+        return;
+    }
+    const QByteArray data = in.readAll();
+    out << "MDL " << QFileInfo(path).completeBaseName() << " loaded.\n";
+    out.flush();
+    if (delayMs > 0)
+        QThread::msleep(ulong(delayMs));
+    QDir().mkpath(outDir);
+    const QString target = outDir % "/" % QFileInfo(path).fileName();
+    QFile written(target);
+    if (!written.open(QIODevice::WriteOnly) || written.write(data) != data.size())
+    {
+        out << "*** Cannot write " << target << "\n";
+        out.flush();
+        return;
+    }
+    const QString name = QFileInfo(path).completeBaseName();
+    const int lineCount = int(sizeof(fixLines) / sizeof(fixLines[0]));
+    const uint seed = qHash(name);
+    const int fixes = int(seed % 4);
+    for (int i = 0; i < fixes; ++i)
+        out << "  " << QString::fromLatin1(fixLines[(seed / 4 + uint(i) * 5) % lineCount]).replace("%1", name) << "\n";
+    out << "Fixes made = " << fixes << "\n" << target << " written.\n";
+    out.flush();
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments().mid(1);
+    args.removeAll("-d");
+    const bool serve = args.removeAll(WorkerProtocol::ServeOption) > 0;
+    QTextStream err(stderr);
+    if (args.isEmpty())
+    {
+        err << "usage: cleanmodels-stub [-d] [" << WorkerProtocol::ServeOption << "] options.pl\n";
+        return 2;
+    }
+    QFile optionsFile(args.first());
+    if (!optionsFile.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        err << "Cannot read " << args.first() << "\n";
+        return 2;
+    }
+    const QString options = QString::fromUtf8(optionsFile.readAll());
+    const int delayMs = qgetenv("CLEANMODELS_STUB_DELAY_MS").toInt();
+    QTextStream out(stdout);
+
+    if (!serve)
+    {
+        const QString inDir = option(options, "g_indir");
+        const QString pattern = option(options, "g_pattern");
+        const QStringList models = QDir(inDir).entryList(QStringList(pattern.isEmpty() ? QString("*.mdl") : pattern), QDir::Files, QDir::Name);
+        for (const QString &model : models)
+            cleanModel(out, inDir % "/" % model, option(options, "g_outdir"), delayMs);
+        return 0;
+    }
+
+    QTextStream in(stdin);
+    QString line;
+    while (in.readLineInto(&line))
+    {
+        const int tab = line.indexOf('\t');
+        const QString path = tab < 0 ? line : line.left(tab);
+        const QString outDir = tab < 0 ? option(options, "g_outdir") : line.mid(tab + 1);
+        if (!path.isEmpty())
+            cleanModel(out, path, outDir, delayMs);
+        out << WorkerProtocol::DoneLine << "\t" << path << "\n";
+        out.flush();
+    }
+    return 0;
+}
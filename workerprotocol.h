@@ -0,0 +1,14 @@
+#ifndef WORKERPROTOCOL_H
+#define WORKERPROTOCOL_H
+
+// Persistent workers are started with ServeOption ahead of their options
+// file. They read one "<model path>\t<output folder>" line per model from
+// stdin, clean it with the usual output and then print a line starting with
+// DoneLine. Closing stdin lets them exit.
+namespace WorkerProtocol
+{
+const char ServeOption[] = "--serve";
+const char DoneLine[] = "@@done";
+}
+
+#endif // WORKERPROTOCOL_H